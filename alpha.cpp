@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "set.hpp"
+
+//////////////////////////////////////////////////////////////////////////////
+template <class Alpha>
+void bench(char const* const name, std::vector<int> const& v)
+{
+  using timer_t = std::chrono::high_resolution_clock;
+
+  sg::set<int, std::compare_three_way, Alpha> st;
+
+  auto t0(timer_t::now());
+
+  for (auto const k: v) st.insert(k);
+
+  auto const ti(std::chrono::nanoseconds(timer_t::now() - t0).count());
+  t0 = timer_t::now();
+
+  std::size_t f{};
+
+  for (auto const k: v) f += st.contains(k);
+
+  auto const tf(std::chrono::nanoseconds(timer_t::now() - t0).count());
+
+  std::cout << name << " alpha " << double(Alpha::num) / Alpha::den <<
+    ": height " << sg::detail::height(st.root()) <<
+    ", insert " << double(ti) / v.size() << " ns/op" <<
+    ", find " << double(tf) / f << " ns/op" << std::endl;
+}
+
+void sweep(char const* const name, std::vector<int> const& v)
+{
+  bench<std::ratio<11, 20>>(name, v);
+  bench<std::ratio<3, 5>>(name, v);
+  bench<std::ratio<2, 3>>(name, v);
+  bench<std::ratio<3, 4>>(name, v);
+  bench<std::ratio<4, 5>>(name, v);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+int main()
+{
+  std::vector<int> v(1 << 18);
+
+  std::iota(v.begin(), v.end(), 0);
+  sweep("sequential", v);
+
+  std::shuffle(v.begin(), v.end(), std::mt19937(std::random_device()()));
+  sweep("random", v);
+
+  return 0;
+}
@@ -0,0 +1,657 @@
+#ifndef SG_BUCKETS_HPP
+# define SG_BUCKETS_HPP
+# pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <compare>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace sg::detail
+{
+
+template <class B, class T>
+class id_iterator
+{ // an element of a bucket B by its id, which the element keeps however the
+  // bucket grows or shifts, -1 is the end
+  template <class, class> friend class id_iterator;
+
+  B* b_{};
+  std::ptrdiff_t i_{};
+
+  auto index() const noexcept { return b_->index(i_); }
+
+public:
+  using iterator_category = std::random_access_iterator_tag;
+  using difference_type = std::ptrdiff_t;
+  using value_type = std::remove_const_t<T>;
+
+  using pointer = T*;
+  using reference = T&;
+
+  id_iterator() = default;
+
+  id_iterator(B* const b, difference_type const i) noexcept:
+    b_(b),
+    i_(i)
+  {
+  }
+
+  template <class C>
+  id_iterator(id_iterator<C, value_type> const& o) noexcept
+    requires(std::is_const_v<T> && std::is_same_v<C const, B>):
+    b_(o.b_),
+    i_(o.i_)
+  {
+  }
+
+  //
+  bool operator==(id_iterator const& o) const noexcept
+  {
+    return (b_ == o.b_) && (i_ == o.i_);
+  }
+
+  auto operator<=>(id_iterator const& o) const noexcept
+  {
+    return index() <=> o.index();
+  }
+
+  //
+  auto& operator++() noexcept { i_ = b_->id(index() + 1); return *this; }
+  auto& operator--() noexcept { i_ = b_->id(index() - 1); return *this; }
+
+  auto operator++(int) noexcept { auto const r(*this); ++*this; return r; }
+  auto operator--(int) noexcept { auto const r(*this); --*this; return r; }
+
+  auto& operator+=(difference_type const k) noexcept
+  {
+    i_ = b_->id(index() + k); return *this;
+  }
+
+  auto& operator-=(difference_type const k) noexcept
+  {
+    i_ = b_->id(index() - k); return *this;
+  }
+
+  friend id_iterator operator+(id_iterator i,
+    difference_type const k) noexcept
+  {
+    return i += k;
+  }
+
+  friend id_iterator operator+(difference_type const k,
+    id_iterator i) noexcept
+  {
+    return i += k;
+  }
+
+  friend id_iterator operator-(id_iterator i,
+    difference_type const k) noexcept
+  {
+    return i -= k;
+  }
+
+  friend difference_type operator-(id_iterator const& a,
+    id_iterator const& b) noexcept
+  {
+    return a.index() - b.index();
+  }
+
+  // member access
+  pointer operator->() const noexcept { return b_->data() + index(); }
+  reference operator*() const noexcept { return b_->data()[index()]; }
+
+  reference operator[](difference_type const k) const noexcept
+  {
+    return b_->data()[index() + k];
+  }
+};
+
+template <class T, class A>
+class inline_bucket
+{ // the first element lives inside the node, a second one moves both to an
+  // array from A that then holds all of them, so a bucket is always
+  // contiguous, as keys are const, elements are moved by constructing them
+  // anew, and if that may throw, into a new array, which replaces the old one
+  // only once complete, so a failure leaves the bucket as it was, every
+  // element has an id, kept as it moves, for the iterators to hold on to
+  template <class, class> friend class id_iterator;
+
+  using traits = std::allocator_traits<A>;
+  using id_traits = typename traits::template rebind_traits<std::uint32_t>;
+
+  static constexpr bool nothrow{std::is_nothrow_move_constructible_v<T>};
+
+  union { T f_; }; // the element, while c_ is 0
+  T* p_{};
+  std::uint32_t* x_{}; // the position of every id, then the id at each one
+  std::uint32_t n_{}, c_{}; // size, capacity of p_ and of ids
+  [[no_unique_address]] A a_;
+
+  std::ptrdiff_t index(std::ptrdiff_t const i) const noexcept
+  { // the position of id i, ids past the elements are free, while c_ is 0
+    // the only id is 0
+    return i < 0 ? n_ : c_ ? x_[i] : 0;
+  }
+
+  std::ptrdiff_t id(std::ptrdiff_t const k) const noexcept
+  {
+    return std::ptrdiff_t(n_) == k ? -1 :
+      c_ ? std::ptrdiff_t(x_[c_ + k]) : 0;
+  }
+
+  void place(decltype(n_) k, decltype(n_) const e) noexcept
+  { // the ids at the positions [k, e) moved
+    for (auto const y(x_ + c_); k != e; ++k) x_[y[k]] = k;
+  }
+
+  void insert_id(decltype(n_) const k) noexcept
+  { // the first free id goes to a new element at k
+    auto const y(x_ + c_);
+    std::rotate(y + k, y + n_, y + n_ + 1);
+
+    place(k, n_ + 1);
+  }
+
+  void erase_ids(decltype(n_) const k, decltype(n_) const m) noexcept
+  { // the ids of the m elements from k on are freed
+    auto const y(x_ + c_);
+    std::rotate(y + k, y + k + m, y + n_);
+
+    place(k, n_);
+  }
+
+  static void relocate(T* const d, T* const s) noexcept
+  { // d is destroyed, s is left moved-from
+    static_assert(nothrow);
+
+    std::destroy_at(d); std::construct_at(d, std::move(*s));
+  }
+
+  auto grown() const
+  {
+    if (std::numeric_limits<decltype(n_)>::max() / 2 < n_)
+    {
+      throw std::length_error("inline_bucket");
+    }
+
+    return std::max(decltype(n_)(4), 2 * n_);
+  }
+
+  void copy_ids(std::uint32_t* const x, decltype(c_) const c) const noexcept
+  { // into x, for c ids, those past the current ones are free
+    for (decltype(c_) i{}, o(c_ ? c_ : 1); i != c; ++i)
+    {
+      x[i] = i < o ? c_ ? x_[i] : 0 : i;
+      x[c + i] = i < o ? c_ ? x_[c_ + i] : 0 : i;
+    }
+  }
+
+  void adopt(T* const p, decltype(c_) const c, std::uint32_t* const x)
+    noexcept
+  { // p, of capacity c, replaces the elements, and x the ids
+    std::destroy_n(data(), n_);
+
+    if (c_)
+    {
+      traits::deallocate(a_, p_, c_);
+
+      if (x != x_)
+      {
+        typename id_traits::allocator_type a(a_);
+        id_traits::deallocate(a, x_, 2 * c_);
+      }
+    }
+
+    p_ = p; x_ = x; c_ = c;
+  }
+
+  template <bool I>
+  void rebuild(decltype(n_) const c, decltype(n_) const k,
+    decltype(n_) const m, auto&& ...a)
+  { // a new array of capacity c, holding the elements with one made from a
+    // inserted at k (I), or with the m from k on dropped, the new element
+    // goes in first, as a may refer to an old one
+    typename id_traits::allocator_type xa(a_);
+
+    auto const x(c == c_ ? x_ : id_traits::allocate(xa, 2 * c));
+    T* p{};
+    auto const d(data());
+    auto const e(I ? n_ + 1 : n_ - m);
+
+    decltype(n_) i{}, j(k); // p[0, i) and p[k, j) are made
+
+    try
+    {
+      p = traits::allocate(a_, c);
+
+      if constexpr(I)
+      {
+        std::construct_at(p + k, std::forward<decltype(a)>(a)...); ++j;
+      }
+
+      for (; i != k; ++i) std::construct_at(p + i, std::move_if_noexcept(d[i]));
+
+      for (; j != e; ++j)
+      {
+        std::construct_at(p + j, std::move_if_noexcept(d[I ? j - 1 : j + m]));
+      }
+    }
+    catch (...)
+    {
+      if (p)
+      {
+        std::destroy_n(p, i); std::destroy(p + k, p + j);
+        traits::deallocate(a_, p, c);
+      }
+
+      if (x != x_) id_traits::deallocate(xa, x, 2 * c);
+
+      throw;
+    }
+
+    if (x != x_) copy_ids(x, c);
+
+    adopt(p, c, x);
+
+    if constexpr(I) insert_id(k); else erase_ids(k, m);
+
+    n_ = e;
+  }
+
+public:
+  using iterator = id_iterator<inline_bucket, T>;
+  using const_iterator = id_iterator<inline_bucket const, T const>;
+  using value_type = T;
+  using size_type = std::size_t;
+  using allocator_type = A;
+
+  explicit inline_bucket(auto const& a) noexcept: a_(a) { }
+
+  inline_bucket(inline_bucket const&) = delete;
+
+  ~inline_bucket()
+  {
+    std::destroy_n(data(), n_);
+
+    if (c_)
+    {
+      traits::deallocate(a_, p_, c_);
+
+      typename id_traits::allocator_type a(a_);
+      id_traits::deallocate(a, x_, 2 * c_);
+    }
+  }
+
+  //
+  inline_bucket& operator=(inline_bucket const&) = delete;
+
+  //
+  size_type size() const noexcept { return n_; }
+  bool empty() const noexcept { return !n_; }
+
+  T* data() noexcept { return c_ ? p_ : &f_; }
+  T const* data() const noexcept { return c_ ? p_ : &f_; }
+
+  auto& front() noexcept { return *data(); }
+  auto& front() const noexcept { return *data(); }
+  auto& back() noexcept { return data()[n_ - 1]; }
+  auto& back() const noexcept { return data()[n_ - 1]; }
+
+  //
+  iterator begin() noexcept { return {this, id(0)}; }
+  iterator end() noexcept { return {this, -1}; }
+  const_iterator begin() const noexcept { return {this, id(0)}; }
+  const_iterator end() const noexcept { return {this, -1}; }
+
+  auto cbegin() const noexcept { return begin(); }
+  auto cend() const noexcept { return end(); }
+
+  //
+  T& emplace_back(auto&& ...a)
+  { // a free id already sits at the end
+    if (n_ == (c_ ? c_ : 1))
+    {
+      rebuild<true>(grown(), n_, 0, std::forward<decltype(a)>(a)...);
+
+      return back();
+    }
+    else
+    {
+      auto const q(data() + n_);
+      std::construct_at(q, std::forward<decltype(a)>(a)...); ++n_;
+
+      return *q;
+    }
+  }
+
+  iterator emplace(const_iterator const i, auto&& ...a)
+  {
+    auto const k(decltype(n_)(i - cbegin()));
+
+    if (n_ == k)
+    {
+      emplace_back(std::forward<decltype(a)>(a)...);
+    }
+    else if (n_ == (c_ ? c_ : 1))
+    {
+      rebuild<true>(grown(), k, 0, std::forward<decltype(a)>(a)...);
+    }
+    else if constexpr(nothrow)
+    { // shift the tail up by one, nothing throws once t is made
+      T t(std::forward<decltype(a)>(a)...);
+
+      auto const d(data());
+      std::construct_at(d + n_, std::move(d[n_ - 1]));
+
+      for (auto j(n_ - 1); j > k; --j) relocate(d + j, d + j - 1);
+
+      relocate(d + k, &t);
+
+      insert_id(k); ++n_;
+    }
+    else
+    {
+      rebuild<true>(c_, k, 0, std::forward<decltype(a)>(a)...);
+    }
+
+    return {this, id(k)};
+  }
+
+  iterator erase(const_iterator const i) noexcept(nothrow)
+  {
+    return erase(i, std::next(i));
+  }
+
+  iterator erase(const_iterator const a, const_iterator const b)
+    noexcept(nothrow)
+  {
+    auto const k(decltype(n_)(a - cbegin()));
+
+    if (auto const m(decltype(n_)(b - a)); m)
+    {
+      auto const d(data());
+
+      if (k + m == n_)
+      { // the ids of the tail are free where they are
+        std::destroy(d + k, d + n_); n_ = k;
+      }
+      else if constexpr(nothrow)
+      { // shift the tail down by m
+        for (auto j(k); j + m < n_; ++j) relocate(d + j, d + j + m);
+
+        std::destroy(d + n_ - m, d + n_);
+
+        erase_ids(k, m); n_ -= m;
+      }
+      else
+      {
+        rebuild<false>(c_, k, m);
+      }
+    }
+
+    return {this, id(k)};
+  }
+
+  size_type remove_if(auto&& pred)
+  { // the survivors are moved down over the removed elements, their ids
+    // with them
+    auto const d(data());
+
+    decltype(n_) i{};
+
+    while ((i != n_) && !pred(d[i])) ++i;
+
+    if (i == n_)
+    {
+      return {};
+    }
+    else if (i + 1 == n_)
+    {
+      std::destroy_at(d + i); --n_;
+
+      return 1;
+    }
+    else if constexpr(nothrow)
+    { // on a throw, the rest is moved down too, there are ids, as there
+      // are 2 elements at least
+      auto j(i);
+
+      auto const keep([&]() noexcept
+        {
+          std::construct_at(d + j, std::move(d[i])); std::destroy_at(d + i);
+
+          std::swap(x_[c_ + j], x_[c_ + i]);
+
+          ++j;
+        }
+      );
+
+      auto const finish([&]() noexcept
+        {
+          place(0, n_);
+
+          return n_ - std::exchange(n_, j);
+        }
+      );
+
+      std::destroy_at(d + i);
+
+      try
+      {
+        while (++i != n_)
+        {
+          if (pred(d[i])) std::destroy_at(d + i); else keep();
+        }
+      }
+      catch (...)
+      {
+        for (; i != n_; ++i) keep();
+
+        finish();
+
+        throw;
+      }
+
+      return finish();
+    }
+    else
+    { // the survivors are copied to a new array, and their ids to new ones
+      typename id_traits::allocator_type xa(a_);
+
+      auto const x(id_traits::allocate(xa, 2 * c_));
+      auto const y(x + c_);
+      T* p{};
+
+      decltype(n_) j{};
+
+      try
+      {
+        p = traits::allocate(a_, c_);
+
+        for (; j != i; ++j)
+        {
+          std::construct_at(p + j, std::move_if_noexcept(d[j]));
+          y[j] = x_[c_ + j];
+        }
+
+        while (++i != n_)
+        {
+          if (!pred(d[i]))
+          {
+            std::construct_at(p + j, std::move_if_noexcept(d[i]));
+            y[j++] = x_[c_ + i];
+          }
+        }
+      }
+      catch (...)
+      {
+        if (p)
+        {
+          std::destroy_n(p, j); traits::deallocate(a_, p, c_);
+        }
+
+        id_traits::deallocate(xa, x, 2 * c_);
+
+        throw;
+      }
+
+      // the ids left out are free
+      std::fill_n(x, c_, ~std::uint32_t{});
+
+      for (decltype(n_) k{}; k != j; ++k) x[y[k]] = k;
+
+      for (decltype(c_) k{}, f(j); k != c_; ++k)
+      {
+        if (~std::uint32_t{} == x[k])
+        {
+          y[f] = k; x[k] = f++;
+        }
+      }
+
+      auto const n(n_);
+      adopt(p, c_, x);
+
+      return n - (n_ = j);
+    }
+  }
+};
+
+template <class T>
+class counted_bucket
+{ // equal elements that are indistinguishable, held as one element and the
+  // number of times it repeats, with the part of the std::list interface the
+  // containers use, erasing the n-th repetition erases the last one
+  T v_;
+  std::size_t n_{1};
+
+public:
+  class iterator
+  {
+    counted_bucket const* b_{};
+    std::ptrdiff_t i_{};
+
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = T;
+
+    using pointer = T const*;
+    using reference = T const&;
+
+    iterator() = default;
+
+    iterator(counted_bucket const* const b, difference_type const i) noexcept:
+      b_(b),
+      i_(i)
+    {
+    }
+
+    //
+    bool operator==(iterator const& o) const noexcept
+    {
+      return (b_ == o.b_) && (i_ == o.i_);
+    }
+
+    auto operator<=>(iterator const& o) const noexcept { return i_ <=> o.i_; }
+
+    //
+    auto& operator++() noexcept { ++i_; return *this; }
+    auto& operator--() noexcept { --i_; return *this; }
+
+    auto operator++(int) noexcept { auto const r(*this); ++i_; return r; }
+    auto operator--(int) noexcept { auto const r(*this); --i_; return r; }
+
+    auto& operator+=(difference_type const k) noexcept
+    {
+      i_ += k; return *this;
+    }
+
+    auto& operator-=(difference_type const k) noexcept
+    {
+      i_ -= k; return *this;
+    }
+
+    friend iterator operator+(iterator i, difference_type const k) noexcept
+    {
+      return i += k;
+    }
+
+    friend iterator operator+(difference_type const k, iterator i) noexcept
+    {
+      return i += k;
+    }
+
+    friend iterator operator-(iterator i, difference_type const k) noexcept
+    {
+      return i -= k;
+    }
+
+    friend difference_type operator-(iterator const& a,
+      iterator const& b) noexcept
+    {
+      return a.i_ - b.i_;
+    }
+
+    // member access
+    pointer operator->() const noexcept { return &b_->v_; }
+    reference operator*() const noexcept { return b_->v_; }
+    reference operator[](difference_type) const noexcept { return b_->v_; }
+  };
+
+  using const_iterator = iterator;
+  using value_type = T;
+  using size_type = std::size_t;
+
+  explicit counted_bucket(auto&& ...a)
+    noexcept(noexcept(T(std::forward<decltype(a)>(a)...)))
+    requires(std::is_constructible_v<T, decltype(a)...>):
+    v_(std::forward<decltype(a)>(a)...)
+  {
+  }
+
+  //
+  auto size() const noexcept { return n_; }
+  bool empty() const noexcept { return !n_; }
+
+  auto& front() const noexcept { return v_; }
+  auto& back() const noexcept { return v_; }
+
+  //
+  iterator begin() const noexcept { return {this, 0}; }
+  iterator end() const noexcept { return {this, std::ptrdiff_t(n_)}; }
+
+  auto cbegin() const noexcept { return begin(); }
+  auto cend() const noexcept { return end(); }
+
+  // the arguments make an element equal to the one held, so are unused
+  auto& emplace_back(auto&& ...) noexcept { ++n_; return v_; }
+
+  iterator emplace(const_iterator const i, auto&& ...) noexcept
+  {
+    ++n_; return i;
+  }
+
+  iterator erase(const_iterator const i) noexcept { --n_; return i; }
+
+  iterator erase(const_iterator const a, const_iterator const b) noexcept
+  {
+    n_ -= b - a; return a;
+  }
+
+  size_type remove_if(auto&& pred)
+  { // pred is asked once for all the repetitions
+    return pred(std::as_const(v_)) ? std::exchange(n_, 0) : 0;
+  }
+};
+
+}
+
+#endif // SG_BUCKETS_HPP
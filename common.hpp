@@ -46,21 +46,68 @@ const_reverse_iterator rend() const noexcept
 auto crbegin() const noexcept { return rbegin(); }
 auto crend() const noexcept { return rend(); }
 
+// cursors
+cursor begin_cursor() noexcept
+{
+  return {&root_, detail::path<node>().first(root_)};
+}
+
+cursor end_cursor() noexcept { return cursor(&root_); }
+
+const_cursor begin_cursor() const noexcept
+{
+  return {&root_, detail::path<node>().first(root_)};
+}
+
+const_cursor end_cursor() const noexcept { return const_cursor(&root_); }
+
 // self-assign neglected
 auto& operator=(this_class const& o)
-  noexcept(noexcept(clear(), insert(o.begin(), o.end())))
+  noexcept(noexcept(clear(), insert_sorted(o.begin(), o.end())))
   requires(std::is_copy_constructible_v<value_type>)
 {
-  if (this != &o) clear(), insert(o.begin(), o.end());
+  if (this != &o) clear(), insert_sorted(o.begin(), o.end());
 
   return *this;
 }
 
 auto& operator=(this_class&& o)
-  noexcept(noexcept(delete root_))
+  noexcept(noexcept(delete root_) &&
+    (std::allocator_traits<node_allocator>::
+      propagate_on_container_move_assignment::value ||
+    std::allocator_traits<node_allocator>::is_always_equal::value))
 {
-  delete root_;
+  using traits = std::allocator_traits<node_allocator>;
+
+  if constexpr(!traits::propagate_on_container_move_assignment::value &&
+    !traits::is_always_equal::value)
+  {
+    if (a_ != o.a_)
+    { // nodes cannot change hands, move the elements instead
+      clear();
+      insert(std::make_move_iterator(o.begin()),
+        std::make_move_iterator(o.end()));
+      o.clear();
+
+      return *this;
+    }
+  }
+
+  detail::destroy(a_, root_);
+
+  if constexpr(traits::propagate_on_container_move_assignment::value)
+  {
+    a_ = std::move(o.a_);
+  }
+
   detail::assign(root_, o.root_)(o.root_, nullptr);
+  detail::assign(sz_, mx_, o.sz_, o.mx_)(o.sz_, o.mx_, size_type{},
+    size_type{});
+
+  if constexpr(requires{ this->nn_; })
+  {
+    detail::assign(this->nn_, o.nn_)(o.nn_, size_type{});
+  }
 
   return *this;
 }
@@ -91,18 +138,55 @@ friend auto operator<=>(this_class const& l, this_class const& r)
 //
 auto root() const noexcept { return root_; }
 
+size_type key_count() const noexcept
+{ // distinct keys, one per node
+  if constexpr(requires{ this->nn_; }) return this->nn_; else return sz_;
+}
+
+//
+auto get_allocator() const noexcept { return allocator_type(a_); }
+
+void reserve(size_type const n)
+  requires(requires(node_allocator& a){ a.reserve(n); })
+{ // room for n more nodes, if the allocator pools them
+  a_.reserve(n);
+}
+
 //
 static constexpr size_type max_size() noexcept
 {
   return ~size_type{} / sizeof(node*);
 }
 
-void clear() noexcept(noexcept(delete root_)) { delete root_; root_ = {}; }
-bool empty() const noexcept { return !root_; }
+void clear() noexcept(noexcept(delete root_))
+{
+  detail::destroy(a_, root_); root_ = {}; sz_ = mx_ = {};
+
+  if constexpr(requires{ this->nn_; }) this->nn_ = {};
+}
+
+bool empty() const noexcept { return !sz_; }
+auto size() const noexcept { return sz_; }
 
 void swap(this_class& o) noexcept
 {
-  detail::assign(root_, o.root_)(o.root_, root_);
+  if constexpr(std::allocator_traits<node_allocator>::
+    propagate_on_container_swap::value)
+  {
+    std::swap(a_, o.a_);
+  }
+  else
+  {
+    assert(a_ == o.a_);
+  }
+
+  detail::assign(root_, o.root_, sz_, o.sz_, mx_, o.mx_)(
+    o.root_, root_, o.sz_, sz_, o.mx_, mx_);
+
+  if constexpr(requires{ this->nn_; })
+  {
+    detail::assign(this->nn_, o.nn_)(o.nn_, this->nn_);
+  }
 }
 
 //
@@ -116,10 +200,63 @@ bool contains(auto const& k) const noexcept
 auto contains(key_type const k) const noexcept { return contains<0>(k); }
 
 //
-iterator erase(const_iterator a, const_iterator const b)
-  noexcept(noexcept(erase(a)))
-{
-  while (a != b) { a = erase(a); } return {&root_, a.n()};
+iterator erase(const_iterator const a, const_iterator const b)
+  noexcept(noexcept(delete root_) && detail::NothrowErasable<node>)
+{ // whole nodes are cut out of the tree at once, in O(log n + k)
+  auto f(a.n());
+  auto const l(b.n());
+
+  if constexpr(requires{ root_->v_; })
+  { // trim the buckets straddling the boundaries, a bucket that throws is
+    // left as it was
+    if (f == l)
+    {
+      if (!f) return end();
+
+      auto const s(f->v_.size());
+      auto const i(f->v_.erase(a.i(), b.i()));
+      sz_ -= s - f->v_.size();
+      detail::refresh(root_, f);
+
+      return {&root_, f, i};
+    }
+
+    if (a.i() != f->v_.cbegin())
+    {
+      auto const s(f->v_.size());
+      f->v_.erase(a.i(), f->v_.cend());
+      sz_ -= s - f->v_.size();
+      detail::refresh(root_, f);
+
+      f = detail::next_node(root_, f);
+    }
+
+    if (l && (b.i() != l->v_.cbegin()))
+    {
+      auto const s(l->v_.size());
+      l->v_.erase(l->v_.cbegin(), b.i());
+      sz_ -= s - l->v_.size();
+      detail::refresh(root_, l);
+    }
+  }
+
+  if (f != l)
+  {
+    auto const [nn, s](detail::erase_range(a_, root_, f, l));
+
+    if constexpr(requires{ this->nn_; })
+    {
+      this->nn_ -= nn; sz_ -= s;
+      detail::compact(root_, this->nn_, mx_, nn);
+    }
+    else
+    {
+      sz_ -= s;
+      detail::compact(root_, sz_, mx_, nn);
+    }
+  }
+
+  return {&root_, l};
 }
 
 iterator erase(std::initializer_list<const_iterator> const l)
@@ -155,6 +292,38 @@ const_iterator find(auto const& k) const noexcept
 
 auto find(key_type const k) const noexcept { return find<0>(k); }
 
+//
+void find_many(std::ranges::random_access_range auto const& k, auto const o)
+  noexcept
+{ // o[i] = find(k[i]), with the searches interleaved, for batches of keys
+  // in trees too big for the cache
+  detail::find_many(root_, std::ranges::size(k),
+    [&](auto const i) noexcept -> auto& { return k[i]; },
+    [&](auto const i, auto const n) noexcept { o[i] = iterator(&root_, n); }
+  );
+}
+
+void find_many(std::ranges::random_access_range auto const& k, auto const o)
+  const noexcept
+{
+  detail::find_many(root_, std::ranges::size(k),
+    [&](auto const i) noexcept -> auto& { return k[i]; },
+    [&](auto const i, auto const n) noexcept
+    {
+      o[i] = const_iterator(&root_, n);
+    }
+  );
+}
+
+void contains_many(std::ranges::random_access_range auto const& k,
+  auto const o) const noexcept
+{
+  detail::find_many(root_, std::ranges::size(k),
+    [&](auto const i) noexcept -> auto& { return k[i]; },
+    [&](auto const i, auto const n) noexcept { o[i] = bool(n); }
+  );
+}
+
 //
 void insert(std::initializer_list<value_type> const l)
   noexcept(noexcept(insert(l.begin(), l.end())))
@@ -162,6 +331,224 @@ void insert(std::initializer_list<value_type> const l)
   insert(l.begin(), l.end());
 }
 
+void insert_sorted(std::input_iterator auto const i, decltype(i) j)
+{ // O(size() + n) for input sorted by key, sort-then-build otherwise
+  auto const key([](auto const& e) noexcept -> auto const&
+    {
+      return detail::key_of<node>(e);
+    }
+  );
+
+  auto const less([&](auto const& a, auto const& b) noexcept
+    {
+      return node::cmp(key(a), key(b)) < 0;
+    }
+  );
+
+  auto const merge([&](auto const i, decltype(i) j)
+    {
+      detail::merge(
+        root_,
+        i,
+        j,
+        key,
+        [&](auto&& e)
+        {
+          auto const n(
+            detail::make_node<node>(a_, std::forward<decltype(e)>(e)));
+
+          if constexpr(requires{ this->nn_; }) ++this->nn_;
+          ++sz_;
+
+          return n;
+        },
+        [&](auto const n, auto&& e)
+        { // unique keys keep the element already present
+          if constexpr(requires{ this->nn_; })
+          {
+            n->v_.emplace_back(std::forward<decltype(e)>(e)); ++sz_;
+          }
+        }
+      );
+    }
+  );
+
+  if constexpr(std::forward_iterator<decltype(i)>)
+  {
+    if (std::is_sorted(i, j, less)) return merge(i, j);
+  }
+
+  using sortable_t = typename decltype([]() noexcept
+    {
+      if constexpr(std::is_same_v<key_type, value_type>)
+      {
+        return std::type_identity<key_type>();
+      }
+      else
+      {
+        return std::type_identity<
+          std::pair<key_type, std::tuple_element_t<1, value_type>>>();
+      }
+    }()
+  )::type;
+
+  std::vector<sortable_t> v(i, j);
+  std::stable_sort(v.begin(), v.end(), less);
+
+  merge(std::make_move_iterator(v.begin()), std::make_move_iterator(v.end()));
+}
+
+//
+auto& join(this_class& o)
+{ // take over the elements of o, whose keys all lie below or all above ours
+  if (this == &o) return *this;
+
+  if (a_ != o.a_)
+  { // nodes cannot change hands
+    insert_sorted(std::make_move_iterator(o.begin()),
+      std::make_move_iterator(o.end()));
+    o.clear();
+
+    return *this;
+  }
+
+  if (!root_ || !o.root_ ||
+    (node::cmp(detail::last_node(root_)->key(),
+      detail::first_node(o.root_)->key()) < 0))
+  {
+    root_ = detail::join(root_, key_count(), o.root_, o.key_count());
+  }
+  else
+  {
+    assert(node::cmp(detail::last_node(o.root_)->key(),
+      detail::first_node(root_)->key()) < 0);
+    root_ = detail::join(o.root_, o.key_count(), root_, key_count());
+  }
+
+  if constexpr(requires{ this->nn_; })
+  {
+    detail::assign(this->nn_, o.nn_)(this->nn_ + o.nn_, size_type{});
+  }
+
+  detail::assign(sz_, mx_, o.sz_, o.mx_, o.root_)(
+    sz_ + o.sz_, mx_ + o.mx_, size_type{}, size_type{}, nullptr);
+
+  return *this;
+}
+
+template <int = 0>
+this_class split(auto const& k)
+{ // detach the elements not less than k, the smaller part gets rebuilt
+  this_class r{allocator_type(a_)};
+
+  if (a_ != r.a_)
+  { // nodes cannot change hands
+    iterator const i(&root_, detail::path<node>().lower_bound(root_, k).top());
+
+    r.insert_sorted(std::make_move_iterator(i),
+      std::make_move_iterator(end()));
+    erase(i, end());
+
+    return r;
+  }
+
+  r.root_ = detail::split(root_, k);
+
+  auto const [s, nn, sz](detail::smaller(root_, r.root_));
+  auto const [x, y](s ? std::tie(*this, r) : std::tie(r, *this));
+
+  if constexpr(requires{ this->nn_; })
+  {
+    detail::assign(y.nn_, x.nn_)(this->nn_ - nn, nn);
+  }
+
+  detail::assign(y.sz_, x.sz_, y.mx_, x.mx_)(sz_ - sz, sz, mx_, nn);
+
+  if (x.root_)
+  {
+    detail::set_parent(
+      x.root_ = detail::build(detail::flatten(x.root_), nn), nullptr);
+  }
+
+  return r;
+}
+
+auto split(key_type const k) { return split<0>(k); }
+
+friend auto join(this_class a, this_class b)
+{
+  return std::move(a.join(b));
+}
+
+size_type erase_if(auto pred)
+  noexcept(noexcept(pred(std::declval<reference>())))
+{ // a single pass, the survivors are rebuilt perfectly balanced
+  auto const sz(sz_);
+
+  detail::erase_if(a_, root_, mx_, sz_, pred);
+
+  if constexpr(requires{ this->nn_; }) this->nn_ = mx_;
+
+  return sz - sz_;
+}
+
+// order statistics, with subtree counts
+iterator nth(size_type const k) noexcept requires(detail::Counted<node*>)
+{
+  auto const [n, i](detail::select(root_, k));
+
+  if constexpr(requires{ root_->v_; })
+  {
+    return n ? iterator(&root_, n, std::next(n->v_.begin(), i)) : end();
+  }
+  else
+  {
+    return {&root_, n};
+  }
+}
+
+const_iterator nth(size_type const k) const noexcept
+  requires(detail::Counted<node*>)
+{
+  auto const [n, i](detail::select(root_, k));
+
+  if constexpr(requires{ root_->v_; })
+  {
+    return n ? const_iterator(&root_, n, std::next(n->v_.cbegin(), i)) :
+      end();
+  }
+  else
+  {
+    return {&root_, n};
+  }
+}
+
+template <int = 0>
+size_type rank(auto const& k) const noexcept
+  requires(detail::Counted<node*> &&
+    detail::Comparable<Compare, decltype(k), key_type>)
+{ // the number of elements with keys less than k
+  return detail::rank(root_, k);
+}
+
+auto rank(key_type const k) const noexcept { return rank<0>(k); }
+
+template <int = 0>
+size_type count_range(auto const& a, auto const& b) const noexcept
+  requires(detail::Counted<node*> &&
+    detail::Comparable<Compare, decltype(a), key_type> &&
+    detail::Comparable<Compare, decltype(b), key_type>)
+{ // the number of elements with keys in [a, b)
+  auto const ra(detail::rank(root_, a)), rb(detail::rank(root_, b));
+
+  return rb > ra ? rb - ra : size_type{};
+}
+
+auto count_range(key_type const a, key_type const b) const noexcept
+{
+  return count_range<0>(a, b);
+}
+
 //
 template <int = 0>
 iterator lower_bound(auto const& k) noexcept
@@ -184,6 +571,51 @@ auto lower_bound(key_type const k) const noexcept
   return lower_bound<0>(k);
 }
 
+void lower_bound_many(std::ranges::random_access_range auto const& k,
+  auto const o) noexcept
+{ // o[i] = lower_bound(k[i]), interleaved like find_many()
+  detail::find_many<true>(root_, std::ranges::size(k),
+    [&](auto const i) noexcept -> auto& { return k[i]; },
+    [&](auto const i, auto const n) noexcept { o[i] = iterator(&root_, n); }
+  );
+}
+
+void lower_bound_many(std::ranges::random_access_range auto const& k,
+  auto const o) const noexcept
+{
+  detail::find_many<true>(root_, std::ranges::size(k),
+    [&](auto const i) noexcept -> auto& { return k[i]; },
+    [&](auto const i, auto const n) noexcept
+    {
+      o[i] = const_iterator(&root_, n);
+    }
+  );
+}
+
+template <int = 0>
+cursor lower_bound_cursor(auto const& k) noexcept
+  requires(detail::Comparable<Compare, decltype(k), key_type>)
+{
+  return {&root_, detail::path<node>().lower_bound(root_, k)};
+}
+
+auto lower_bound_cursor(key_type const k) noexcept
+{
+  return lower_bound_cursor<0>(k);
+}
+
+template <int = 0>
+const_cursor lower_bound_cursor(auto const& k) const noexcept
+  requires(detail::Comparable<Compare, decltype(k), key_type>)
+{
+  return {&root_, detail::path<node>().lower_bound(root_, k)};
+}
+
+auto lower_bound_cursor(key_type const k) const noexcept
+{
+  return lower_bound_cursor<0>(k);
+}
+
 //
 template <int = 0>
 iterator upper_bound(auto const& k) noexcept
@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "map.hpp"
+#include "frozen.hpp"
+
+//////////////////////////////////////////////////////////////////////////////
+void bench(char const* const name, auto const& c, std::vector<int> const& q)
+{
+  using timer_t = std::chrono::high_resolution_clock;
+
+  auto const t0(timer_t::now());
+
+  std::size_t f{};
+
+  for (auto const k: q) f += (*c.find(k)).second;
+
+  auto const t(std::chrono::nanoseconds(timer_t::now() - t0).count());
+
+  std::cout << name << ": find " << double(t) / q.size() << " ns/op (" <<
+    f << ")" << std::endl;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void bench_many(char const* const name, auto const& c,
+  std::vector<int> const& q)
+{ // batches of 256 keys, as a request handler would look them up
+  using timer_t = std::chrono::high_resolution_clock;
+
+  std::vector<decltype(c.begin())> r(256);
+
+  auto const t0(timer_t::now());
+
+  std::size_t f{};
+
+  for (std::size_t i{}; i < q.size(); i += r.size())
+  {
+    c.find_many(std::span(q).subspan(i, r.size()), r.begin());
+
+    for (auto const& j: r) f += (*j).second;
+  }
+
+  auto const t(std::chrono::nanoseconds(timer_t::now() - t0).count());
+
+  std::cout << name << ": find_many " << double(t) / q.size() <<
+    " ns/op (" << f << ")" << std::endl;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+int main()
+{
+  std::mt19937 g(std::random_device{}());
+
+  std::vector<int> v(1 << 22);
+
+  std::iota(v.begin(), v.end(), 0);
+  std::shuffle(v.begin(), v.end(), g);
+
+  sg::map<int, int> m;
+
+  for (auto const k: v) m.emplace(k, k & 1);
+
+  sg::frozen_map<int, int> const fm(m);
+
+  std::shuffle(v.begin(), v.end(), g);
+
+  bench("sg::map", m, v);
+  bench_many("sg::map", m, v);
+  bench("sg::frozen_map", fm, v);
+
+  return 0;
+}
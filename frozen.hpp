@@ -0,0 +1,490 @@
+#ifndef SG_FROZEN_HPP
+# define SG_FROZEN_HPP
+# pragma once
+
+#include "utils.hpp"
+
+namespace sg
+{
+
+namespace detail
+{
+
+// 1-based Eytzinger (BFS) indices: the children of i are 2i and 2i + 1,
+// 0 stands for none
+constexpr size_type eytzinger_first(size_type const n) noexcept
+{
+  return std::bit_floor(n);
+}
+
+constexpr size_type eytzinger_last(size_type const n) noexcept
+{
+  return std::bit_floor(n + 1) - 1;
+}
+
+constexpr size_type eytzinger_next(size_type i, size_type const n) noexcept
+{ // in-order successor, the leftmost node of the right subtree or the
+  // first ancestor reached from the left
+  if (auto const r(2 * i + 1); r <= n)
+  {
+    i = r << (std::bit_width(n) - std::bit_width(r));
+
+    return i > n ? i >> 1 : i;
+  }
+
+  return i >> (std::countr_one(i) + 1);
+}
+
+constexpr size_type eytzinger_prev(size_type i, size_type const n) noexcept
+{ // in-order predecessor, the predecessor of 0 being the last node
+  if (!i)
+  {
+    return eytzinger_last(n);
+  }
+  else if (auto const l(2 * i); l <= n)
+  {
+    auto const k(std::bit_width(n) - std::bit_width(l));
+    i = ((l + 1) << k) - 1;
+
+    return i > n ? i >> 1 : i;
+  }
+
+  return i >> (std::countr_zero(i) + 1);
+}
+
+}
+
+template <typename Key, typename Value, class Compare, bool Multi>
+class frozen
+{ // immutable, keys stored apart from the values in Eytzinger order, the
+  // multi-containers keep their buckets in CSR form: the elements of all
+  // buckets in one sorted array, indexed by an end offset per key
+  static constexpr bool mapped = !std::is_void_v<Value>;
+
+  using element_type = std::conditional_t<mapped, Value, Key>;
+
+  static constinit inline Compare const cmp;
+
+  template <typename K>
+  static constexpr bool comparable{detail::Comparable<Compare, K, Key>};
+
+  // the descendants of i, 2^d levels down, fill about a cache line
+  static constexpr auto prefetch_depth{
+    std::bit_width(std::max(64 / sizeof(Key), std::size_t(2))) - 1};
+
+public:
+  using key_type = Key;
+  using value_type = std::conditional_t<mapped,
+    std::pair<Key const, element_type>, Key>;
+
+  using difference_type = detail::difference_type;
+  using size_type = detail::size_type;
+  using reference = std::conditional_t<mapped,
+    std::pair<Key const&, element_type const&>, Key const&>;
+  using const_reference = reference;
+
+  class const_iterator;
+  using iterator = const_iterator;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+private:
+  std::vector<Key> k_; // key of index i at i - 1
+  std::vector<element_type> v_; // Eytzinger order, CSR order if Multi
+  std::vector<size_type> o_; // Multi: end of bucket i in v_ at i - 1
+
+  static auto& key_of(auto const& v) noexcept
+  {
+    if constexpr(mapped) return std::get<0>(v); else return v;
+  }
+
+  static auto& element_of(auto const& v) noexcept
+  {
+    if constexpr(mapped) return std::get<1>(v); else return v;
+  }
+
+  size_type first_of(size_type const i) const noexcept
+  { // offset of the first element of bucket i
+    auto const p(i ? detail::eytzinger_prev(i, k_.size()) : 0);
+
+    return p ? o_[p - 1] : 0;
+  }
+
+  template <bool Upper = false>
+  size_type bound(auto const& k) const noexcept
+  { // branchless descent to the first key not less than (Upper: greater
+    // than) k: left turns append 0, right turns 1 to the index, strip the
+    // right turns taken after the last left turn, and that turn itself
+    auto const n(k_.size());
+    auto const d(k_.data());
+
+    size_type i(1);
+
+    while (i <= n)
+    {
+      detail::prefetch(d, (i << prefetch_depth) - 1);
+
+      if constexpr(Upper)
+      {
+        i = 2 * i + (cmp(d[i - 1], k) <= 0);
+      }
+      else
+      {
+        i = 2 * i + (cmp(d[i - 1], k) < 0);
+      }
+    }
+
+    return i >> (std::countr_one(i) + 1);
+  }
+
+  const_iterator at_key(size_type const i) const noexcept
+  { // the first element filed under key i
+    if constexpr(Multi)
+    {
+      return {this, i, i ? first_of(i) : v_.size()};
+    }
+    else
+    {
+      return {this, i};
+    }
+  }
+
+  static auto count(auto i, decltype(i) const j)
+  { // distinct keys and elements in the sorted range [i, j)
+    size_type n{}, m{};
+
+    for (; i != j; ++n)
+    {
+      auto const& x(key_of(*i));
+
+      do ++m; while ((++i != j) && (cmp(key_of(*i), x) == 0));
+    }
+
+    return std::pair(n, m);
+  }
+
+  frozen(std::forward_iterator auto i, decltype(i) const j,
+    std::pair<size_type, size_type> const nm)
+  { // a single pass over [i, j), holding nm.first keys and nm.second
+    // elements, the elements are kept by address where [i, j) yields
+    // lvalues, as cursors are bulky
+    auto const [n, m](nm);
+
+    using handle_t = std::conditional_t<
+      std::is_lvalue_reference_v<decltype(*i)>,
+      std::remove_reference_t<decltype(*i)>*,
+      decltype(i)
+    >;
+
+    std::vector<handle_t> h(n); // the first element of every key
+
+    if constexpr(Multi)
+    {
+      o_.resize(n);
+      v_.reserve(m);
+    }
+
+    auto const f([&](auto const& f, size_type const x) -> void
+      { // an in-order walk over the implicit tree consumes [i, j) in order
+        if (x > n) return;
+
+        f(f, 2 * x);
+
+        if constexpr(std::is_pointer_v<handle_t>)
+        {
+          h[x - 1] = std::addressof(*i);
+        }
+        else
+        {
+          h[x - 1] = i;
+        }
+
+        auto const& k(key_of(*h[x - 1]));
+
+        do
+        {
+          if constexpr(Multi) v_.emplace_back(element_of(*i));
+        }
+        while ((++i != j) && (cmp(key_of(*i), k) == 0));
+
+        if constexpr(Multi) o_[x - 1] = v_.size();
+
+        f(f, 2 * x + 1);
+      }
+    );
+
+    f(f, 1);
+
+    k_.reserve(n);
+
+    if constexpr(mapped && !Multi) v_.reserve(n);
+
+    for (auto const& e: h)
+    { // Eytzinger order, one sequential pass
+      k_.emplace_back(key_of(*e));
+
+      if constexpr(mapped && !Multi) v_.emplace_back(element_of(*e));
+    }
+  }
+
+public:
+  class const_iterator
+  {
+    friend class frozen;
+
+    frozen const* f_{};
+    size_type i_{}; // Eytzinger index, 0 past the end
+    [[no_unique_address]] std::conditional_t<Multi, size_type,
+      detail::empty> j_{}; // Multi: offset into v_
+
+    const_iterator(frozen const* const f, size_type const i,
+      auto const ...j) noexcept:
+      f_(f),
+      i_(i)
+    {
+      ((j_ = j), ...);
+    }
+
+  public:
+    using iterator_category = std::bidirectional_iterator_tag;
+
+    using difference_type = frozen::difference_type;
+    using value_type = frozen::value_type;
+    using reference = frozen::reference;
+
+    struct pointer
+    {
+      reference r_;
+
+      auto operator->() const noexcept { return &r_; }
+    };
+
+    const_iterator() = default;
+
+    //
+    bool operator==(const_iterator const& o) const noexcept
+    {
+      if constexpr(Multi) return j_ == o.j_; else return i_ == o.i_;
+    }
+
+    //
+    auto& operator++() noexcept
+    {
+      if constexpr(Multi)
+      {
+        if (++j_ == f_->o_[i_ - 1])
+        {
+          i_ = detail::eytzinger_next(i_, f_->k_.size());
+        }
+      }
+      else
+      {
+        i_ = detail::eytzinger_next(i_, f_->k_.size());
+      }
+
+      return *this;
+    }
+
+    auto& operator--() noexcept
+    {
+      auto const p(detail::eytzinger_prev(i_, f_->k_.size()));
+
+      if constexpr(Multi)
+      {
+        --j_;
+
+        if (!i_ || (p && (j_ < f_->o_[p - 1]))) i_ = p;
+      }
+      else
+      {
+        i_ = p;
+      }
+
+      return *this;
+    }
+
+    auto operator++(int) noexcept { auto r(*this); ++*this; return r; }
+    auto operator--(int) noexcept { auto r(*this); --*this; return r; }
+
+    //
+    reference operator*() const noexcept
+    {
+      auto const& k(f_->k_[i_ - 1]);
+
+      if constexpr(Multi && mapped)
+      {
+        return {k, f_->v_[j_]};
+      }
+      else if constexpr(Multi)
+      {
+        return f_->v_[j_];
+      }
+      else if constexpr(mapped)
+      {
+        return {k, f_->v_[i_ - 1]};
+      }
+      else
+      {
+        return k;
+      }
+    }
+
+    auto operator->() const noexcept
+    {
+      if constexpr(mapped) return pointer{**this}; else return &**this;
+    }
+  };
+
+  frozen() = default;
+
+  frozen(std::forward_iterator auto const i, decltype(i) const j):
+    frozen(i, j, count(i, j))
+  { // [i, j) must be sorted by key, as are all sg containers, equal keys
+    // past the first are dropped unless Multi
+  }
+
+  explicit frozen(auto const& c)
+    requires(std::forward_iterator<decltype(c.begin())> &&
+      !requires{ c.key_count(); }):
+    frozen(c.begin(), c.end())
+  {
+  }
+
+  explicit frozen(auto const& c)
+    requires(requires{ c.key_count(); c.begin_cursor(); }):
+    frozen(c.begin_cursor(), c.end_cursor(),
+      std::pair(c.key_count(), c.size()))
+  { // an sg container knows its key count, so a single in-order walk with
+    // its cursors, amortized O(1) per step, fills the snapshot
+  }
+
+  //
+  auto size() const noexcept
+  {
+    if constexpr(Multi) return v_.size(); else return k_.size();
+  }
+
+  bool empty() const noexcept { return k_.empty(); }
+  static constexpr size_type max_size() noexcept { return ~size_type{}; }
+
+  //
+  const_iterator begin() const noexcept
+  {
+    return at_key(detail::eytzinger_first(k_.size()));
+  }
+
+  const_iterator end() const noexcept { return at_key(0); }
+
+  auto cbegin() const noexcept { return begin(); }
+  auto cend() const noexcept { return end(); }
+
+  auto rbegin() const noexcept { return const_reverse_iterator(end()); }
+  auto rend() const noexcept { return const_reverse_iterator(begin()); }
+
+  auto crbegin() const noexcept { return rbegin(); }
+  auto crend() const noexcept { return rend(); }
+
+  //
+  template <int = 0>
+  auto equal_range(auto const& k) const noexcept
+    requires(comparable<decltype(k)>)
+  {
+    auto const i(bound(k));
+
+    if (i && (cmp(k, k_[i - 1]) == 0))
+    {
+      auto const n(detail::eytzinger_next(i, k_.size()));
+
+      if constexpr(Multi)
+      {
+        return std::pair(at_key(i), const_iterator(this, n, o_[i - 1]));
+      }
+      else
+      {
+        return std::pair(at_key(i), at_key(n));
+      }
+    }
+
+    return std::pair(at_key(i), at_key(i));
+  }
+
+  auto equal_range(key_type const k) const noexcept
+  {
+    return equal_range<0>(k);
+  }
+
+  template <int = 0>
+  auto lower_bound(auto const& k) const noexcept
+    requires(comparable<decltype(k)>)
+  {
+    return at_key(bound(k));
+  }
+
+  auto lower_bound(key_type const k) const noexcept
+  {
+    return lower_bound<0>(k);
+  }
+
+  template <int = 0>
+  auto upper_bound(auto const& k) const noexcept
+    requires(comparable<decltype(k)>)
+  {
+    return at_key(bound<true>(k));
+  }
+
+  auto upper_bound(key_type const k) const noexcept
+  {
+    return upper_bound<0>(k);
+  }
+
+  template <int = 0>
+  auto find(auto const& k) const noexcept
+    requires(comparable<decltype(k)>)
+  {
+    auto const i(bound(k));
+
+    return at_key(i && (cmp(k, k_[i - 1]) == 0) ? i : 0);
+  }
+
+  auto find(key_type const k) const noexcept { return find<0>(k); }
+
+  template <int = 0>
+  bool contains(auto const& k) const noexcept
+    requires(comparable<decltype(k)>)
+  {
+    auto const i(bound(k));
+
+    return i && (cmp(k, k_[i - 1]) == 0);
+  }
+
+  auto contains(key_type const k) const noexcept { return contains<0>(k); }
+
+  template <int = 0>
+  size_type count(auto const& k) const noexcept
+    requires(comparable<decltype(k)>)
+  {
+    auto const i(bound(k));
+
+    if (!i || (cmp(k, k_[i - 1]) != 0)) return {};
+
+    if constexpr(Multi) return o_[i - 1] - first_of(i); else return 1;
+  }
+
+  auto count(key_type const k) const noexcept { return count<0>(k); }
+};
+
+template <typename Key, class Compare = std::compare_three_way>
+using frozen_set = frozen<Key, void, Compare, false>;
+
+template <typename Key, typename Value, class Compare = std::compare_three_way>
+using frozen_map = frozen<Key, Value, Compare, false>;
+
+template <typename Key, class Compare = std::compare_three_way>
+using frozen_multiset = frozen<Key, void, Compare, true>;
+
+template <typename Key, typename Value, class Compare = std::compare_three_way>
+using frozen_multimap = frozen<Key, Value, Compare, true>;
+
+}
+
+#endif // SG_FROZEN_HPP
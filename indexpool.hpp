@@ -0,0 +1,300 @@
+#ifndef SG_INDEXPOOL_HPP
+# define SG_INDEXPOOL_HPP
+# pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <bit>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace sg::detail
+{
+
+template <class N>
+struct chunks
+{ // nodes of type N live in chunks of C bytes, aligned to C, that start
+  // with a header: the chunk table of their pool and their own index in it,
+  // a node index is the chunk index shifted left by S bits, plus the slot
+  struct header
+  {
+    std::byte* const* t_;
+    std::uint32_t i_;
+    std::uint32_t k_; // chunks in the slab this chunk starts, if any
+  };
+
+  static constexpr std::size_t C{
+    std::bit_ceil(std::max(std::size_t(4096), 32 * sizeof(N)))};
+
+  static constexpr std::size_t L{C / sizeof(N)}; // slots per chunk
+  static constexpr std::size_t F{ // the first slot past the header
+    (sizeof(header) + sizeof(N) - 1) / sizeof(N)};
+
+  static constexpr unsigned S{unsigned(std::bit_width(L - 1))};
+  static constexpr std::uint32_t M{(std::uint32_t(1) << S) - 1};
+
+  static constexpr std::size_t max_chunks{std::size_t(1) << (32 - S)};
+
+  static_assert(F < L);
+
+  static auto header_of(void const* const p) noexcept
+  {
+    return reinterpret_cast<header const*>(
+      reinterpret_cast<std::uintptr_t>(p) & ~std::uintptr_t(C - 1));
+  }
+
+  static N* node(std::byte* const* const t, std::uint32_t const i) noexcept
+  {
+    return reinterpret_cast<N*>(t[i >> S] + (i & M) * sizeof(N));
+  }
+
+  static std::uint32_t index(N const* const n) noexcept
+  {
+    auto const h(header_of(n));
+
+    return h->i_ << S | std::uint32_t(
+      (reinterpret_cast<std::byte const*>(n) -
+      reinterpret_cast<std::byte const*>(h)) / sizeof(N));
+  }
+};
+
+template <class N>
+class link
+{ // a 32-bit index of a node, resolved through the chunk the link itself
+  // lives in, so links only exist inside nodes and are never copied, 0 is
+  // none
+  std::uint32_t i_{};
+
+public:
+  using node_type = N;
+
+  link() = default;
+  link(link const&) = delete;
+
+  //
+  link& operator=(link const& o) noexcept { return *this = o.get(); }
+
+  link& operator=(N* const n) noexcept
+  {
+    i_ = n ? chunks<N>::index(n) : 0; return *this;
+  }
+
+  //
+  N* get() const noexcept
+  {
+    return i_ ? chunks<N>::node(chunks<N>::header_of(this)->t_, i_) :
+      nullptr;
+  }
+
+  operator N*() const noexcept { return get(); }
+  N* operator->() const noexcept { return get(); }
+};
+
+template <class T, class A>
+class index_pool
+{ // allocates nodes linked by link<T> out of chunks obtained from A, every
+  // instance owns its chunks, copies start out empty
+  template <class, class> friend class index_pool;
+
+  using layout = chunks<T>;
+
+  struct alignas(layout::C) chunk { std::byte b_[layout::C]; };
+
+  using traits = std::allocator_traits<A>;
+  using chunk_allocator = typename traits::template rebind_alloc<chunk>;
+  using table_allocator = typename traits::template rebind_alloc<std::byte*>;
+
+  [[no_unique_address]] A a_;
+
+  std::byte** t_{}; // chunk table
+  std::size_t n_{}, u_{}, c_{}; // chunks allocated, in use, table capacity
+
+  std::byte* f_{}; // free slots, linked through their first bytes
+  std::byte* b_{}, *e_{}; // unused tail of the newest chunk in use
+
+  void table(std::size_t const c)
+  { // a bigger table, the headers of all chunks are pointed at it
+    table_allocator ta(a_);
+
+    auto const t(std::allocator_traits<table_allocator>::allocate(ta, c));
+    std::copy_n(t_, n_, t);
+
+    if (t_) std::allocator_traits<table_allocator>::deallocate(ta, t_, c_);
+
+    t_ = t; c_ = c;
+
+    for (std::size_t i{}; i != n_; ++i)
+    {
+      reinterpret_cast<typename layout::header*>(t_[i])->t_ = t_;
+    }
+  }
+
+  void add(std::size_t const n)
+  { // allocate a slab of chunks for at least n more nodes, slabs grow with
+    // the pool, as every aligned allocation may waste up to a chunk
+    auto k(std::max((n + layout::L - layout::F - 1) / (layout::L - layout::F),
+      std::min(n_, std::size_t(256))));
+
+    if (k = std::min(k, layout::max_chunks - n_); !k) throw std::bad_alloc();
+
+    if (auto c(c_); n_ + k > c)
+    {
+      for (c = c ? c : 16; c < n_ + k; c *= 2);
+
+      table(std::min(c, layout::max_chunks));
+    }
+
+    chunk_allocator ca(a_);
+
+    auto c(reinterpret_cast<std::byte*>(
+      std::allocator_traits<chunk_allocator>::allocate(ca, k)));
+
+    for (std::size_t i{}; i != k; ++i, c += layout::C)
+    {
+      ::new (c) typename layout::header{t_, std::uint32_t(n_),
+        std::uint32_t(i ? 0 : k)};
+      t_[n_++] = c;
+    }
+  }
+
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+  using is_always_equal = std::false_type;
+
+  index_pool() = default;
+
+  index_pool(A const& a) noexcept: a_(a) { }
+
+  index_pool(index_pool const& o) noexcept: a_(o.a_) { }
+
+  template <class U>
+  index_pool(index_pool<U, A> const& o) noexcept: a_(o.a_) { }
+
+  index_pool(index_pool&& o) noexcept:
+    a_(o.a_),
+    t_(std::exchange(o.t_, {})),
+    n_(std::exchange(o.n_, {})),
+    u_(std::exchange(o.u_, {})),
+    c_(std::exchange(o.c_, {})),
+    f_(std::exchange(o.f_, {})),
+    b_(std::exchange(o.b_, {})),
+    e_(std::exchange(o.e_, {}))
+  {
+  }
+
+  ~index_pool() { release(); }
+
+  //
+  index_pool& operator=(index_pool const&) = delete;
+
+  index_pool& operator=(index_pool&& o) noexcept
+  {
+    if (this != &o)
+    {
+      release();
+
+      a_ = o.a_;
+      t_ = std::exchange(o.t_, {});
+      n_ = std::exchange(o.n_, {});
+      u_ = std::exchange(o.u_, {});
+      c_ = std::exchange(o.c_, {});
+      f_ = std::exchange(o.f_, {});
+      b_ = std::exchange(o.b_, {});
+      e_ = std::exchange(o.e_, {});
+    }
+
+    return *this;
+  }
+
+  bool operator==(index_pool const& o) const noexcept
+  {
+    return this == &o;
+  }
+
+  operator A() const noexcept { return a_; }
+
+  //
+  auto select_on_container_copy_construction() const
+  {
+    return index_pool(traits::select_on_container_copy_construction(a_));
+  }
+
+  //
+  T* allocate([[maybe_unused]] std::size_t const n)
+  { // only single nodes, they have to live in chunks
+    static_assert(sizeof(T) >= sizeof(f_));
+    assert(1 == n);
+
+    if (f_)
+    {
+      auto const b(f_);
+      std::memcpy(&f_, b, sizeof(f_));
+
+      return reinterpret_cast<T*>(b);
+    }
+    else if (b_ == e_)
+    {
+      if (u_ == n_) add(1);
+
+      b_ = t_[u_++];
+      e_ = b_ + layout::L * sizeof(T);
+      b_ += layout::F * sizeof(T);
+    }
+
+    return reinterpret_cast<T*>(std::exchange(b_, b_ + sizeof(T)));
+  }
+
+  void deallocate(T* const p, std::size_t) noexcept
+  {
+    auto const b(reinterpret_cast<std::byte*>(p));
+    std::memcpy(b, &f_, sizeof(f_)); f_ = b;
+  }
+
+  //
+  void release() noexcept
+  { // free all chunks at once, outstanding nodes become invalid
+    if (t_)
+    {
+      chunk_allocator ca(a_);
+
+      for (std::size_t i{}; i != n_;)
+      {
+        auto const k(reinterpret_cast<typename layout::header*>(t_[i])->k_);
+
+        std::allocator_traits<chunk_allocator>::deallocate(ca,
+          reinterpret_cast<chunk*>(t_[i]), k);
+
+        i += k;
+      }
+
+      table_allocator ta(a_);
+      std::allocator_traits<table_allocator>::deallocate(ta, t_, c_);
+    }
+
+    t_ = {}; n_ = u_ = c_ = {}; f_ = b_ = e_ = {};
+  }
+
+  void reserve(std::size_t const n)
+  { // make room for n more nodes, the chunks go in use as needed
+    auto const r(std::size_t(e_ - b_) / sizeof(T) +
+      (n_ - u_) * (layout::L - layout::F));
+
+    if (r < n) add(n - r);
+  }
+};
+
+}
+
+#endif // SG_INDEXPOOL_HPP
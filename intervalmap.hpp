@@ -4,13 +4,17 @@
 
 #include "utils.hpp"
 
+#include "multimapcursor.hpp"
 #include "multimapiterator.hpp"
+#include "overlapiterator.hpp"
 
 namespace sg
 {
 
 template <typename Key, typename Value,
-  class Compare = std::compare_three_way>
+  class Compare = std::compare_three_way, class Alpha = std::ratio<2, 3>,
+  node_policy Policy = plain_nodes,
+  class Allocator = std::allocator<std::pair<Key const, Value>>>
 class intervalmap
 {
 public:
@@ -19,6 +23,7 @@ public:
   using key_type = Key;
   using mapped_type = Value;
   using value_type = std::pair<Key const, Value>;
+  using allocator_type = Allocator;
 
   using difference_type = detail::difference_type;
   using size_type = detail::size_type;
@@ -30,18 +35,72 @@ public:
   using const_iterator = multimapiterator<node const>;
   using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
+  using cursor = multimapcursor<node>;
+  using const_cursor = multimapcursor<node const>;
+
+  using overlap_iterator = overlapiterator<node>;
+  using const_overlap_iterator = overlapiterator<node const>;
+
   struct node
   {
     using value_type = intervalmap::value_type;
 
+    using alpha = Alpha;
+
     static constinit inline Compare const cmp;
 
-    node* l_{}, *r_{};
+    detail::link_t<node, Policy> l_{}, r_{};
+    [[no_unique_address]] detail::parent_t<node, Policy> p_{};
+
+    using end_type = std::tuple_element_t<1, Key>;
+
+    static auto& end_of(auto const& v) noexcept
+    {
+      return std::get<1>(std::get<0>(v));
+    }
+
+    using bucket_base = detail::inline_bucket<value_type,
+      typename std::allocator_traits<Allocator>::template
+        rebind_alloc<value_type>>;
+
+    class bucket: public bucket_base
+    { // intervals sharing a start, sorted by end, equal ends in the order
+      // of insertion, so the intervals that end past a point are a suffix
+      using base = bucket_base;
+
+    public:
+      using typename base::const_iterator;
+      using typename base::iterator;
+
+      using base::base;
+
+      auto& max() const noexcept { return end_of(base::back()); }
+
+      //
+      auto& emplace_back(auto&& ...a)
+      {
+        return *emplace(base::cend(), std::forward<decltype(a)>(a)...);
+      }
+
+      iterator emplace(const_iterator, auto&& ...a)
+      { // the end of the interval decides where it goes, not the hint, so
+        // the interval is made before the bucket changes, which a throw
+        // from base::emplace() then leaves as it was
+        value_type v(std::forward<decltype(a)>(a)...);
 
-    typename std::tuple_element_t<1, Key> m_;
-    std::list<value_type> v_;
+        return base::emplace(std::upper_bound(base::cbegin(), base::cend(),
+          end_of(v), [](auto& e, auto& u) noexcept
+          {
+            return cmp(e, end_of(u)) < 0;
+          }), std::move(v));
+      }
+    };
+
+    end_type m_;
+    bucket v_;
 
-    explicit node(auto&& k, auto&& ...a)
+    explicit node(std::allocator_arg_t, auto const& al, auto&& k,
+      auto&& ...a)
       noexcept(noexcept(
           v_.emplace_back(
             std::piecewise_construct_t{},
@@ -49,7 +108,8 @@ public:
             std::forward_as_tuple(std::forward<decltype(a)>(a)...)
           )
         )
-      )
+      ):
+      v_(al)
     {
       v_.emplace_back(
         std::piecewise_construct_t{},
@@ -60,12 +120,7 @@ public:
       assert(std::get<0>(std::get<0>(v_.back())) <=
         std::get<1>(std::get<0>(v_.back())));
 
-      m_ = std::get<1>(std::get<0>(v_.back()));
-    }
-
-    ~node() noexcept(std::is_nothrow_destructible_v<decltype(v_)>)
-    {
-      delete l_; delete r_;
+      m_ = v_.max();
     }
 
     //
@@ -74,10 +129,16 @@ public:
       return std::get<0>(std::get<0>(v_.front()));
     }
 
+    static auto& key_of(auto const& v) noexcept
+    {
+      return std::get<0>(std::get<0>(v));
+    }
+
     //
-    static auto emplace(auto& r, auto&& k, auto&& ...a)
+    static auto emplace(auto& al, auto& r, size_type const sz,
+      auto&& k, auto&& ...a)
       noexcept(noexcept(
-          new node(
+          detail::create_node(al,
             std::forward<decltype(k)>(k),
             std::forward<decltype(a)>(a)...
           )
@@ -91,52 +152,65 @@ public:
         >
       )
     {
-      auto const& [mink, maxk](k);
+      auto const& mink(std::get<0>(k));
 
       node* q;
+      bool s{};
 
-      auto const f([&](auto&& f, auto& n)
+      auto const f([&, h(detail::max_depth<Alpha>(sz + 1))](auto&& f,
+        detail::slot<node> const qn, node* const p, size_type const d)
         noexcept(noexcept(
-            new node(
+            detail::create_node(al,
               std::forward<decltype(k)>(k),
               std::forward<decltype(a)>(a)...
             )
           )
         ) -> size_type
         {
+          auto const n(qn.get());
+
           if (!n)
           {
-            n = q = new node(
+            qn.set(q = detail::create_node(
+                al,
                 std::forward<decltype(k)>(k),
                 std::forward<decltype(a)>(a)...
-              );
+              )
+            );
+            s = true;
 
-            return 1;
+            detail::set_parent(q, p);
+
+            return d > h;
           }
 
-          //
-          n->m_ = cmp(n->m_, maxk) < 0 ? maxk : n->m_;
+          // the maxima are raised on the way back up, once the interval is
+          // in place, so a throw leaves them as they were
+          auto const raise([n](auto const& m)
+            {
+              if (cmp(n->m_, m) < 0) n->m_ = m;
+            }
+          );
 
-          //
           size_type sl, sr;
 
           if (auto const c(cmp(mink, n->key())); c < 0)
           {
-            if (sl = f(f, n->l_); !sl)
-            {
-              return {};
-            }
+            sl = f(f, detail::slot_of(n->l_), n, d + 1);
+            raise(detail::left_node(n)->m_);
+
+            if (!sl) return {};
 
-            sr = detail::size(n->r_);
+            sr = detail::size(detail::right_node(n));
           }
           else if (c > 0)
           {
-            if (sr = f(f, n->r_); !sr)
-            {
-              return {};
-            }
+            sr = f(f, detail::slot_of(n->r_), n, d + 1);
+            raise(detail::right_node(n)->m_);
 
-            sl = detail::size(n->l_);
+            if (!sr) return {};
+
+            sl = detail::size(detail::left_node(n));
           }
           else
           {
@@ -145,20 +219,22 @@ public:
               std::forward_as_tuple(std::forward<decltype(k)>(k)),
               std::forward_as_tuple(std::forward<decltype(a)>(a)...)
             );
+            raise(n->v_.max());
 
             return {};
           }
 
           //
-          auto const s(1 + sl + sr), S(2 * s);
+          auto const s(1 + sl + sr);
 
-          return (3 * sl > S) || (3 * sr > S) ? (n = n->rebalance(s), 0) : s;
+          return detail::unbalanced<Alpha>(std::max(sl, sr), s) ?
+            (qn.set(detail::rebalance(n, s)), 0) : s;
         }
       );
 
-      f(f, r);
+      f(f, detail::slot_of(r), {}, {});
 
-      return q;
+      return std::pair(q, s);
     }
 
     static auto equal_range(auto n, auto&& k) noexcept
@@ -189,304 +265,119 @@ public:
       return std::pair(n ? n : g, g);
     }
 
-    static iterator erase(auto& r, const_iterator const i)
+    static iterator erase(auto& al, auto& r, const_iterator const i)
     {
       if (auto const n(i.n()); 1 == n->v_.size())
       {
-        return {&r, std::get<0>(node::erase(r, std::get<0>(*i)))};
+        auto const [q, p](detail::node_slot(r, n));
+
+        return {&r, node::erase(al, r, q, p)};
       }
       else if (auto const it(i.i()); std::next(it) == n->v_.end())
       {
         auto const nn(std::next(i).n());
 
         n->v_.erase(it);
+        detail::refresh(r, n);
 
         return {&r, nn};
       }
       else
       {
-        return {&r, n, n->v_.erase(it)};
-      }
-    }
-
-    static auto erase(auto& r0, auto&& k)
-    {
-      using pointer = typename std::remove_cvref_t<decltype(r0)>;
-      using node = std::remove_pointer_t<pointer>;
-
-      if (r0)
-      {
-        auto const& [mink, maxk](k);
-
-        pointer p{};
-
-        for (auto q(&r0);;)
-        {
-          auto const n(*q);
-
-          if (auto const c(node::cmp(mink, n->key())); c < 0)
-          {
-            detail::assign(p, q)(n, &n->l_);
-          }
-          else if (c > 0)
-          {
-            detail::assign(p, q)(n, &n->r_);
-          }
-          else
-          {
-            size_type const s(n->v_.size());
-            auto const nxt(detail::next_node(r0, n));
-
-            if (auto const l(n->l_), r(n->r_); l && r)
-            {
-              if (detail::size(l) < detail::size(r))
-              {
-                auto const [fnn, fnp](detail::first_node2(r, n));
-
-                detail::assign(*q, fnn->l_)(fnn, l);
+        auto const j(n->v_.erase(it));
+        detail::refresh(r, n);
 
-                if (r == fnn)
-                {
-                  reset_max(r0, r->key());
-                }
-                else
-                {
-                  detail::assign(fnp->l_, fnn->r_)(fnn->r_, r);
-
-                  reset_max(r0, fnp->key());
-                }
-              }
-              else
-              {
-                auto const [lnn, lnp](detail::last_node2(l, n));
-
-                detail::assign(*q, lnn->r_)(lnn, r);
-
-                if (l == lnn)
-                {
-                  reset_max(r0, l->key());
-                }
-                else
-                {
-                  detail::assign(lnp->r_, lnn->l_)(lnn->l_, l);
-
-                  reset_max(r0, lnp->key());
-                }
-              }
-            }
-            else
-            {
-              *q = l ? l : r;
-
-              if (p)
-              {
-                reset_max(r0, p->key());
-              }
-            }
-
-            n->l_ = n->r_ = {};
-            delete n;
-
-            return std::pair(nxt, s);
-          }
-        }
+        return {&r, n, j};
       }
-
-      return std::pair(pointer{}, size_type{});
     }
 
-    static auto node_max(auto const n) noexcept
+    template <bool Next = true>
+    static auto erase(auto& al, auto& r0, auto const q, auto const p)
     {
-      decltype(node::m_) m(n->key());
-
-      std::for_each(
-        n->v_.cbegin(),
-        n->v_.cend(),
-        [&](auto&& p) noexcept
-        {
-          auto const tmp(std::get<1>(std::get<0>(p)));
-          m = cmp(m, tmp) < 0 ? tmp : m;
-        }
-      );
-
-      return m;
+      return std::get<0>(detail::erase<Next>(al, r0, q, p));
     }
 
-    static void reset_max(auto const n, auto&& k) noexcept
-      requires(detail::Comparable<Compare, decltype(k), decltype(node::m_)>)
+    static size_type erase(auto& al, auto& r0, auto&& k)
     {
-      auto const f([&](auto&& f, auto const n) noexcept -> decltype(node::m_)
-        {
-          auto m(node_max(n));
-
-          auto const l(n->l_), r(n->r_);
-
-          if (auto const c(cmp(k, n->key())); c < 0)
-          {
-            if (r)
-            {
-              m = cmp(m, r->m_) < 0 ? r->m_ : m;
-            }
-
-            auto const tmp(f(f, l)); // visit left
-            m = cmp(m, tmp) < 0 ? tmp : m;
-          }
-          else if (c > 0)
-          {
-            if (l)
-            {
-              m = cmp(m, l->m_) < 0 ? l->m_ : m;
-            }
-
-            auto const tmp(f(f, r)); // visit right
-            m = cmp(m, tmp) < 0 ? tmp : m;
-          }
-          else // we are there
-          {
-            if (l)
-            {
-              m = cmp(m, l->m_) < 0 ? l->m_ : m;
-            }
-
-            if (r)
-            {
-              m = cmp(m, r->m_) < 0 ? r->m_ : m;
-            }
-          }
+      if (auto const [q, p](detail::find_slot(r0, std::get<0>(k)));
+        q.get())
+      {
+        size_type const s(q.get()->v_.size());
+        node::erase<false>(al, r0, q, p);
 
-          return n->m_ = m;
-        }
-      );
+        return s;
+      }
 
-      f(f, n);
+      return {};
     }
 
-    auto rebalance(size_type const sz) noexcept
-    {
-      auto const l(static_cast<node**>(SG_ALLOCA(sizeof(this) * sz)));
+    static void update(auto const n) noexcept
+    { // O(1), the bucket keeps its own maximum
+      auto m(n->v_.max());
 
+      if (auto const l(detail::left_node(n)); l)
       {
-        auto f([l(l)](auto&& f, auto const n) mutable noexcept -> void
-          {
-            if (n)
-            {
-              f(f, detail::left_node(n));
-
-              *l++ = n;
-
-              f(f, detail::right_node(n));
-            }
-          }
-        );
-
-        f(f, this);
+        m = cmp(m, l->m_) < 0 ? l->m_ : m;
       }
 
-      auto const f([l](auto&& f,
-        std::size_t const a, decltype(a) b) noexcept -> node*
-        {
-          auto const i(std::midpoint(a, b));
-          auto const n(l[i]);
-
-          switch (b - a)
-          {
-            case 0:
-              n->l_ = n->r_ = {};
-
-              n->m_ = node_max(n);
-
-              break;
-
-            case 1:
-              {
-                auto const nb(n->r_ = l[b]);
-
-                n->l_ = nb->l_ = nb->r_ = {};
-
-                n->m_ = std::max(
-                    node_max(n),
-                    nb->m_ = node_max(nb),
-                    [](auto&& a, auto&& b) noexcept
-                    {
-                      return node::cmp(a, b) < 0;
-                    }
-                  );
-
-                break;
-              }
-
-            default:
-              auto const l(f(f, a, i - 1)), r(f(f, i + 1, b));
-              detail::assign(n->l_, n->r_)(l, r);
-
-              n->m_ = std::max(
-                  {node_max(n), l->m_, r->m_},
-                  [](auto&& a, auto&& b) noexcept
-                  {
-                    return node::cmp(a, b) < 0;
-                  }
-                );
-          }
-
-          return n;
-        }
-      );
+      if (auto const r(detail::right_node(n)); r)
+      {
+        m = cmp(m, r->m_) < 0 ? r->m_ : m;
+      }
 
-      return f(f, {}, sz - 1);
+      n->m_ = m;
     }
   };
 
 private:
   using this_class = intervalmap;
+  using node_allocator = detail::node_allocator_t<node, Allocator, Policy>;
+
+  [[no_unique_address]] node_allocator a_;
   node* root_{};
+  size_type nn_{}, sz_{}, mx_{}; // mx_: most nodes since the last full rebuild
 
 public:
   intervalmap() = default;
 
+  explicit intervalmap(Allocator const& a) noexcept: a_(a) { }
+
   intervalmap(intervalmap const& o)
-    noexcept(noexcept(insert(o.begin(), o.end())))
-    requires(std::is_copy_constructible_v<value_type>)
+    requires(std::is_copy_constructible_v<value_type>):
+    a_(std::allocator_traits<node_allocator>::
+      select_on_container_copy_construction(o.a_))
   {
-    insert(o.begin(), o.end());
+    insert_sorted(o.begin(), o.end());
   }
 
-  intervalmap(intervalmap&& o)
-    noexcept(noexcept(*this = std::move(o)))
+  intervalmap(intervalmap&& o) noexcept: a_(std::move(o.a_))
   {
-    *this = std::move(o);
+    detail::assign(root_, nn_, sz_, mx_, o.root_, o.nn_, o.sz_, o.mx_)(
+      o.root_, o.nn_, o.sz_, o.mx_, nullptr, 0u, 0u, 0u);
   }
 
-  intervalmap(std::input_iterator auto const i, decltype(i) j)
-    noexcept(noexcept(insert(i, j)))
-    requires(std::is_constructible_v<value_type, decltype(*i)>)
+  intervalmap(std::input_iterator auto const i, decltype(i) j,
+    Allocator const& a = Allocator())
+    requires(std::is_constructible_v<value_type, decltype(*i)>):
+    a_(a)
   {
-    insert(i, j);
+    insert_sorted(i, j);
   }
 
-  intervalmap(std::initializer_list<value_type> l)
-    noexcept(noexcept(*this = l))
-    requires(std::is_copy_constructible_v<value_type>)
+  intervalmap(std::initializer_list<value_type> l,
+    Allocator const& a = Allocator())
+    requires(std::is_copy_constructible_v<value_type>):
+    intervalmap(l.begin(), l.end(), a)
   {
-    insert(l.begin(), l.end());
   }
 
-  ~intervalmap() noexcept(noexcept(delete root_)) { delete root_; }
-
-# include "common.hpp"
-
-  //
-  auto size() const noexcept
+  ~intervalmap() noexcept(noexcept(delete root_))
   {
-    static constinit auto const f(
-      [](auto&& f, auto const n) noexcept -> size_type
-      {
-        return n ? n->v_.size() + f(f, n->l_) + f(f, n->r_) : 0;
-      }
-    );
-
-    return f(f, root_);
+    detail::destroy(a_, root_);
   }
 
+# include "common.hpp"
+
   //
   template <int = 0>
   size_type count(auto const& k) const noexcept
@@ -498,22 +389,19 @@ public:
       >
     )
   {
-    if (auto n(root_); n)
+    for (auto n(root_); n;)
     {
-      for (;;)
+      if (auto const c(node::cmp(k, n->key())); c < 0)
       {
-        if (auto const c(node::cmp(k, n->key())); c < 0)
-        {
-          n = detail::left_node(n);
-        }
-        else if (c > 0)
-        {
-          n = detail::right_node(n);
-        }
-        else
-        {
-          return n->v_.size();
-        }
+        n = detail::left_node(n);
+      }
+      else if (c > 0)
+      {
+        n = detail::right_node(n);
+      }
+      else
+      {
+        return n->v_.size();
       }
     }
 
@@ -527,21 +415,28 @@ public:
   iterator emplace(auto&& k, auto&& ...a)
     noexcept(noexcept(
         node::emplace(
+          a_,
           root_,
+          nn_,
           std::forward<decltype(k)>(k),
           std::forward<decltype(a)>(a)...
         )
       )
     )
   {
-    return {
-      &root_,
+    auto const [n, s](
       node::emplace(
+        a_,
         root_,
+        nn_,
         std::forward<decltype(k)>(k),
         std::forward<decltype(a)>(a)...
       )
-    };
+    );
+
+    detail::assign(nn_, sz_)(nn_ + s, sz_ + 1);
+
+    return {&root_, n};
   }
 
   auto emplace(key_type k, auto&& ...a)
@@ -583,10 +478,14 @@ public:
   //
   template <int = 0>
   size_type erase(auto&& k)
-    noexcept(noexcept(node::erase(root_, k)))
+    noexcept(noexcept(node::erase(a_, root_, k)))
     requires(!std::convertible_to<decltype(k), const_iterator>)
   {
-    return std::get<1>(node::erase(root_, k));
+    auto const s(node::erase(a_, root_, k));
+    detail::assign(nn_, sz_)(nn_ - bool(s), sz_ - s);
+    detail::compact(root_, nn_, mx_, bool(s));
+
+    return s;
   }
 
   auto erase(key_type k) noexcept(noexcept(erase<0>(std::move(k))))
@@ -595,28 +494,28 @@ public:
   }
 
   iterator erase(const_iterator const i)
-    noexcept(noexcept(node::erase(root_, i)))
+    noexcept(noexcept(node::erase(a_, root_, i)))
   {
-    return node::erase(root_, i);
+    auto const e(1 == i.n()->v_.size());
+    auto const r(node::erase(a_, root_, i));
+
+    detail::assign(nn_, sz_)(nn_ - e, sz_ - 1);
+    detail::compact(root_, nn_, mx_, e);
+
+    return r;
   }
 
   //
   iterator insert(value_type const& v)
-    noexcept(noexcept(node::emplace(root_, std::get<0>(v), std::get<1>(v))))
+    noexcept(noexcept(emplace(std::get<0>(v), std::get<1>(v))))
   {
-    return {
-        &root_,
-        node::emplace(root_, std::get<0>(v), std::get<1>(v))
-      };
+    return emplace(std::get<0>(v), std::get<1>(v));
   }
 
   iterator insert(value_type&& v)
-    noexcept(noexcept(node::emplace(root_, std::get<0>(v), std::get<1>(v))))
+    noexcept(noexcept(emplace(std::get<0>(v), std::get<1>(v))))
   {
-    return {
-        &root_,
-        node::emplace(root_, std::get<0>(v), std::get<1>(v))
-      };
+    return emplace(std::get<0>(v), std::get<1>(v));
   }
 
   void insert(std::input_iterator auto const i, decltype(i) j)
@@ -642,6 +541,21 @@ public:
     );
   }
 
+  //
+  auto overlapping(Key const& k)
+    noexcept(std::is_nothrow_copy_constructible_v<Key>)
+  { // the elements all(k) visits, found one at a time, in iteration order
+    return std::ranges::subrange(overlap_iterator(root_, k),
+      overlap_iterator());
+  }
+
+  auto overlapping(Key const& k) const
+    noexcept(std::is_nothrow_copy_constructible_v<Key>)
+  {
+    return std::ranges::subrange(const_overlap_iterator(root_, k),
+      const_overlap_iterator());
+  }
+
   //
   void all(Key const& k, auto g) const
     noexcept(noexcept(g(std::declval<value_type>())))
@@ -657,25 +571,119 @@ public:
 
           if (auto const cg0(c > 0); cg0 || (eq && (c == 0)))
           {
-            std::for_each(
-              n->v_.cbegin(),
-              n->v_.cend(),
-              [&](auto&& p)
+            // the overlapping intervals end the bucket, in end order
+            for (auto i(n->v_.cend()), b(n->v_.cbegin()); i != b;)
+            {
+              if (auto& p(*--i); node::cmp(mink, node::end_of(p)) < 0)
               {
-                if (node::cmp(mink, std::get<1>(std::get<0>(p))) < 0)
-                {
-                  g(std::forward<decltype(p)>(p));
-                }
+                g(p);
               }
-            );
+              else
+              {
+                break;
+              }
+            }
 
             if (cg0) // maxk > key
             {
-              f(f, n->r_);
+              f(f, detail::right_node(n));
             }
           }
 
-          f(f, n->l_);
+          f(f, detail::left_node(n));
+        }
+      }
+    );
+
+    f(f, root_);
+  }
+
+  void all_batch(std::ranges::input_range auto const& q, auto g) const
+  { // g(i, e) for every element e overlapping the i-th query of q, the
+    // queries are sorted by start and swept along a single in-order walk,
+    // the ones started before the current node and still open are kept on
+    // a heap by end, subtrees they can not overlap are skipped
+    std::vector<std::pair<Key, size_type>> s;
+
+    for (size_type i{}; auto const& k: q) s.emplace_back(k, i++);
+
+    std::ranges::sort(s, [](auto const& a, auto const& b) noexcept
+      {
+        return node::cmp(std::get<0>(a.first), std::get<0>(b.first)) < 0;
+      }
+    );
+
+    auto const start_of([&](size_type const j) noexcept -> auto&
+      {
+        return std::get<0>(s[j].first);
+      }
+    );
+
+    auto const end_of([&](size_type const j) noexcept -> auto&
+      {
+        return std::get<1>(s[j].first);
+      }
+    );
+
+    auto const later([&](size_type const a, size_type const b) noexcept
+      {
+        return node::cmp(end_of(a), end_of(b)) > 0;
+      }
+    );
+
+    std::vector<size_type> h; // open queries
+    size_type j{}; // the first query not yet open
+
+    auto const report([&](size_type const k, auto const n)
+      { // the intervals of n ending past the start of query k
+        auto& v(n->v_);
+
+        for (auto i(std::upper_bound(v.begin(), v.end(), start_of(k),
+          [](auto& x, auto& e) noexcept
+          {
+            return node::cmp(x, node::end_of(e)) < 0;
+          })); v.end() != i; ++i)
+        {
+          g(s[k].second, *i);
+        }
+      }
+    );
+
+    auto const f([&](auto&& f, auto n) -> void
+      {
+        for (; n; n = detail::right_node(n))
+        {
+          if (h.empty() &&
+            ((s.size() == j) || (node::cmp(start_of(j), n->m_) >= 0)))
+          {
+            break;
+          }
+
+          f(f, detail::left_node(n));
+
+          auto const& k(n->key());
+
+          // open the queries starting before k, close those ending by it
+          for (; (s.size() != j) && (node::cmp(start_of(j), k) < 0); ++j)
+          {
+            h.push_back(j);
+            std::ranges::push_heap(h, later);
+          }
+
+          for (; !h.empty() && (node::cmp(end_of(h.front()), k) <= 0);
+            h.pop_back())
+          {
+            std::ranges::pop_heap(h, later);
+          }
+
+          // the open queries and those starting before the bucket ends
+          for (auto const i: h) report(i, n);
+
+          for (auto i(j); (s.size() != i) &&
+            (node::cmp(start_of(i), n->v_.max()) < 0); ++i)
+          {
+            report(i, n);
+          }
         }
       }
     );
@@ -697,28 +705,16 @@ public:
 
         if (cg0 || (eq && (c == 0)))
         {
-          if (auto const i(std::find_if(
-                n->v_.cbegin(),
-                n->v_.cend(),
-                [&](auto&& p) noexcept
-                {
-                  return node::cmp(mink, std::get<1>(std::get<0>(p))) < 0;
-                }
-              )
-            );
-            n->v_.cend() != i
-          )
-          {
-            return true;
-          }
+          if (node::cmp(mink, n->v_.max()) < 0) return true;
         }
 
         //
-        if (auto const l(n->l_); l && (node::cmp(mink, l->m_) < 0))
+        if (auto const l(detail::left_node(n));
+          l && (node::cmp(mink, l->m_) < 0))
         {
           n = l;
         }
-        else if (auto const r(n->r_);
+        else if (auto const r(detail::right_node(n));
           cg0 && r && (node::cmp(mink, r->m_) < 0))
         {
           n = r;
@@ -735,37 +731,48 @@ public:
 };
 
 //////////////////////////////////////////////////////////////////////////////
-template <int = 0, typename K, typename V, class C>
-inline auto erase(intervalmap<K, V, C>& c, auto&& k)
+template <int = 0, typename K, typename V, class C, class A, node_policy P,
+  class M>
+inline auto erase(intervalmap<K, V, C, A, P, M>& c, auto&& k)
   noexcept(noexcept(c.erase(std::forward<decltype(k)>(k))))
 {
   return c.erase(std::forward<decltype(k)>(k));
 }
 
-template <typename K, typename V, class C>
-inline auto erase(intervalmap<K, V, C>& c, K k)
+template <typename K, typename V, class C, class A, node_policy P,
+  class M>
+inline auto erase(intervalmap<K, V, C, A, P, M>& c, K k)
   noexcept(noexcept(erase<0>(c, std::move(k))))
 {
   return erase<0>(c, std::move(k));
 }
 
-template <typename K, typename V, class C>
-inline auto erase_if(intervalmap<K, V, C>& c, auto pred)
-  noexcept(
-    noexcept(pred(std::declval<K>())) &&
-    noexcept(c.erase(c.begin()))
-  )
+template <typename K, typename V, class C, class A, node_policy P,
+  class M>
+inline auto erase_if(intervalmap<K, V, C, A, P, M>& c, auto pred)
+  noexcept(noexcept(c.erase_if(pred)))
 {
-  typename std::remove_reference_t<decltype(c)>::size_type r{};
-
-  for (auto i(c.begin()); i.n(); pred(*i) ? ++r, i = c.erase(i) : ++i);
-
-  return r;
+  return c.erase_if(pred);
 }
 
 //////////////////////////////////////////////////////////////////////////////
-template <typename K, typename V, class C>
-inline void swap(intervalmap<K, V, C>& l, decltype(l) r) noexcept {l.swap(r);}
+template <typename K, typename V, class C, class A, node_policy P,
+  class M>
+inline void swap(intervalmap<K, V, C, A, P, M>& l, decltype(l) r) noexcept
+{
+  l.swap(r);
+}
+
+namespace pmr
+{
+
+template <typename Key, typename Value,
+  class Compare = std::compare_three_way, class Alpha = std::ratio<2, 3>,
+  node_policy Policy = plain_nodes>
+using intervalmap = sg::intervalmap<Key, Value, Compare, Alpha, Policy,
+  std::pmr::polymorphic_allocator<std::pair<Key const, Value>>>;
+
+}
 
 }
 
@@ -42,7 +42,8 @@ void dump(auto n)
 //////////////////////////////////////////////////////////////////////////////
 int main()
 {
-  sg::map<std::string, int> st{
+  sg::map<std::string, int, std::compare_three_way, std::ratio<2, 3>,
+    sg::subtree_counts> st{
     {"a", -1},
     {"c", 1}
   };
@@ -85,7 +86,7 @@ int main()
 
   while (S)
   {
-    st.erase(std::next(st.begin(), rand() % S--));
+    st.erase(st.nth(rand() % S--));
   }
 
   std::cout << std::chrono::nanoseconds(timer_t::now() - t0).count() << std::endl;
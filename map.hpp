@@ -4,13 +4,16 @@
 
 #include "utils.hpp"
 
+#include "mapcursor.hpp"
 #include "mapiterator.hpp"
 
 namespace sg
 {
 
 template <typename Key, typename Value,
-  class Compare = std::compare_three_way>
+  class Compare = std::compare_three_way, class Alpha = std::ratio<2, 3>,
+  node_policy Policy = plain_nodes,
+  class Allocator = std::allocator<std::pair<Key const, Value>>>
 class map
 {
 public:
@@ -19,6 +22,7 @@ public:
   using key_type = Key;
   using mapped_type = Value;
   using value_type = std::pair<Key const, Value>;
+  using allocator_type = Allocator;
 
   using difference_type = detail::difference_type;
   using size_type = detail::size_type;
@@ -30,13 +34,20 @@ public:
   using const_iterator = mapiterator<node const>;
   using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
+  using cursor = mapcursor<node>;
+  using const_cursor = mapcursor<node const>;
+
   struct node
   {
     using value_type = map::value_type;
 
+    using alpha = Alpha;
+
     static constinit inline Compare const cmp;
 
-    node* l_{}, *r_{};
+    detail::link_t<node, Policy> l_{}, r_{};
+    [[no_unique_address]] detail::parent_t<node, Policy> p_{};
+    [[no_unique_address]] detail::count_t<Policy> c_{1};
     value_type kv_;
 
     explicit node(auto&& k, auto&& ...a)
@@ -50,27 +61,44 @@ public:
     {
     }
 
-    ~node() noexcept(std::is_nothrow_destructible_v<decltype(kv_)>)
-    {
-      delete l_; delete r_;
-    }
-
     //
     auto& key() const noexcept { return std::get<0>(kv_); }
 
     //
     template <int = 0>
-    static auto emplace(auto& r, auto&& k, auto&& ...a)
+    static auto emplace(auto& al, auto& r, size_type const sz,
+      auto&& k, auto&& ...a)
+      noexcept(noexcept(new node(std::forward<decltype(k)>(k),
+        std::forward<decltype(a)>(a)...)))
+      requires(detail::Comparable<Compare, decltype(k), key_type>)
+    {
+      return detail::emplace(r, sz, k, [&]()
+          noexcept(noexcept(new node(
+            std::forward<decltype(k)>(k),
+            std::forward<decltype(a)>(a)...)))
+          {
+            return detail::create_node(
+                al,
+                std::forward<decltype(k)>(k),
+                std::forward<decltype(a)>(a)...
+              );
+          }
+        );
+    }
+
+    static auto emplace_hint(auto& al, auto& r, size_type const sz,
+      node* const h, auto&& k, auto&& ...a)
       noexcept(noexcept(new node(std::forward<decltype(k)>(k),
         std::forward<decltype(a)>(a)...)))
       requires(detail::Comparable<Compare, decltype(k), key_type>)
     {
-      return detail::emplace(r, k, [&]()
+      return detail::emplace_hint(r, sz, h, k, [&]()
           noexcept(noexcept(new node(
             std::forward<decltype(k)>(k),
             std::forward<decltype(a)>(a)...)))
           {
-            return new node(
+            return detail::create_node(
+                al,
                 std::forward<decltype(k)>(k),
                 std::forward<decltype(a)>(a)...
               );
@@ -81,51 +109,62 @@ public:
 
 private:
   using this_class = map;
+  using node_allocator = detail::node_allocator_t<node, Allocator, Policy>;
+
+  [[no_unique_address]] node_allocator a_;
   node* root_{};
+  size_type sz_{}, mx_{}; // mx_: most nodes since the last full rebuild
 
 public:
   map() = default;
 
+  explicit map(Allocator const& a) noexcept: a_(a) { }
+
   map(map const& o)
-    noexcept(noexcept(map(o.begin(), o.end())))
     requires(std::is_copy_constructible_v<value_type>):
-    map(o.begin(), o.end())
+    a_(std::allocator_traits<node_allocator>::
+      select_on_container_copy_construction(o.a_))
   {
+    insert_sorted(o.begin(), o.end());
   }
 
-  map(map&& o)
-    noexcept(noexcept(*this = std::move(o)))
+  map(map&& o) noexcept: a_(std::move(o.a_))
   {
-    *this = std::move(o);
+    detail::assign(root_, sz_, mx_, o.root_, o.sz_, o.mx_)(
+      o.root_, o.sz_, o.mx_, nullptr, 0u, 0u);
   }
 
-  map(std::input_iterator auto const i, decltype(i) j)
-    noexcept(noexcept(insert(i, j)))
+  map(std::input_iterator auto const i, decltype(i) j,
+    Allocator const& a = Allocator()):
+    a_(a)
   {
-    insert(i, j);
+    insert_sorted(i, j);
   }
 
-  map(std::initializer_list<value_type> l)
-    noexcept(noexcept(map(l.begin(), l.end()))):
-    map(l.begin(), l.end())
+  map(std::initializer_list<value_type> l,
+    Allocator const& a = Allocator())
+    noexcept(noexcept(map(l.begin(), l.end(), a))):
+    map(l.begin(), l.end(), a)
   {
   }
 
-  ~map() noexcept(noexcept(delete root_)) { delete root_; }
+  ~map() noexcept(noexcept(delete root_)) { detail::destroy(a_, root_); }
 
 # include "common.hpp"
-
-  //
-  auto size() const noexcept { return detail::size(root_); }
+# include "setops.hpp"
 
   //
   template <int = 0>
   auto& operator[](auto&& k)
-    noexcept(noexcept(node::emplace(root_, std::forward<decltype(k)>(k))))
+    noexcept(noexcept(
+      node::emplace(a_, root_, sz_, std::forward<decltype(k)>(k))))
     requires(detail::Comparable<Compare, decltype(k), key_type>)
   {
-    return std::get<1>(std::get<0>(
-      node::emplace(root_, std::forward<decltype(k)>(k)))->kv_);
+    auto const [n, s](
+      node::emplace(a_, root_, sz_, std::forward<decltype(k)>(k)));
+    sz_ += s;
+
+    return std::get<1>(n->kv_);
   }
 
   auto& operator[](key_type k)
@@ -181,7 +220,9 @@ public:
   auto emplace(auto&& k, auto&& ...a)
     noexcept(noexcept(
         node::emplace(
+          a_,
           root_,
+          sz_,
           std::forward<decltype(k)>(k),
           std::forward<decltype(a)>(a)...
         )
@@ -191,11 +232,14 @@ public:
   {
     auto const [n, s](
       node::emplace(
+        a_,
         root_,
+        sz_,
         std::forward<decltype(k)>(k),
         std::forward<decltype(a)>(a)...
       )
     );
+    sz_ += s;
 
     return std::pair(iterator(&root_, n), s);
   }
@@ -207,6 +251,43 @@ public:
     return emplace<0>(std::move(k), std::forward<decltype(a)>(a)...);
   }
 
+  template <int = 0>
+  iterator emplace_hint(const_iterator const h, auto&& k, auto&& ...a)
+    noexcept(noexcept(
+        node::emplace_hint(
+          a_,
+          root_,
+          sz_,
+          h.n(),
+          std::forward<decltype(k)>(k),
+          std::forward<decltype(a)>(a)...
+        )
+      )
+    )
+    requires(detail::Comparable<Compare, decltype(k), key_type>)
+  {
+    auto const [n, s](
+      node::emplace_hint(
+        a_,
+        root_,
+        sz_,
+        h.n(),
+        std::forward<decltype(k)>(k),
+        std::forward<decltype(a)>(a)...
+      )
+    );
+    sz_ += s;
+
+    return {&root_, n};
+  }
+
+  auto emplace_hint(const_iterator const h, key_type k, auto&& ...a)
+    noexcept(noexcept(
+      emplace_hint<0>(h, std::move(k), std::forward<decltype(a)>(a)...)))
+  {
+    return emplace_hint<0>(h, std::move(k), std::forward<decltype(a)>(a)...);
+  }
+
   //
   template <int = 0>
   auto equal_range(auto const& k) noexcept
@@ -236,11 +317,15 @@ public:
   //
   template <int = 0>
   size_type erase(auto const& k)
-    noexcept(noexcept(detail::erase(root_, k)))
+    noexcept(noexcept(detail::erase(a_, root_, k)))
     requires(detail::Comparable<Compare, decltype(k), key_type> &&
       !std::convertible_to<decltype(k), const_iterator>)
   {
-    return bool(detail::erase(root_, k));
+    auto const s(detail::erase(a_, root_, k));
+    sz_ -= s;
+    detail::compact(root_, sz_, mx_, s);
+
+    return size_type(s);
   }
 
   auto erase(key_type const k) noexcept(noexcept(erase<0>(k)))
@@ -249,15 +334,21 @@ public:
   }
 
   iterator erase(const_iterator const i)
-    noexcept(noexcept(detail::erase(root_, std::get<0>(*i))))
+    noexcept(noexcept(delete root_))
   {
-    return {&root_, detail::erase(root_, std::get<0>(*i))};
+    auto const [q, p](detail::node_slot(root_, i.n()));
+    --sz_;
+
+    iterator const r(&root_, std::get<0>(detail::erase(a_, root_, q, p)));
+    detail::compact(root_, sz_, mx_, 1);
+
+    return r;
   }
 
   //
   template <int = 0>
   auto insert(auto&& v)
-    noexcept(noexcept(node::emplace(root_,
+    noexcept(noexcept(node::emplace(a_, root_, sz_,
       std::get<0>(std::forward<decltype(v)>(v)),
       std::get<1>(std::forward<decltype(v)>(v)))))
     requires(
@@ -268,9 +359,10 @@ public:
       >
     )
   {
-    auto const [n, s](node::emplace(root_,
+    auto const [n, s](node::emplace(a_, root_, sz_,
       std::get<0>(std::forward<decltype(v)>(v)),
       std::get<1>(std::forward<decltype(v)>(v))));
+    sz_ += s;
 
     return std::pair(iterator(&root_, n), s);
   }
@@ -281,6 +373,13 @@ public:
     return insert<0>(std::move(v));
   }
 
+  iterator insert(const_iterator const h, value_type v)
+    noexcept(noexcept(
+      emplace_hint(h, std::get<0>(v), std::move(std::get<1>(v)))))
+  {
+    return emplace_hint(h, std::get<0>(v), std::move(std::get<1>(v)));
+  }
+
   void insert(std::input_iterator auto const i, decltype(i) j)
     noexcept(noexcept(emplace(std::get<0>(*i), std::get<1>(*i))))
   {
@@ -309,7 +408,9 @@ public:
   auto insert_or_assign(auto&& k, auto&& ...b)
     noexcept(noexcept(
         node::emplace(
+          a_,
           root_,
+          sz_,
           std::forward<decltype(k)>(k),
           std::forward<decltype(b)>(b)...
         )
@@ -319,12 +420,16 @@ public:
   {
     auto const [n, s](
       node::emplace(
+        a_,
         root_,
+        sz_,
         std::forward<decltype(k)>(k),
         std::forward<decltype(b)>(b)...
       )
     );
 
+    sz_ += s;
+
     if (!s)
     {
       if constexpr(sizeof...(b))
@@ -351,43 +456,58 @@ public:
 };
 
 //////////////////////////////////////////////////////////////////////////////
-template <int = 0, typename K, typename V, class C>
-inline auto erase(map<K, V, C>& c, auto const& k)
+template <int = 0, typename K, typename V, class C, class A, node_policy P,
+  class M>
+inline auto erase(map<K, V, C, A, P, M>& c, auto const& k)
   noexcept(noexcept(c.erase(K(k))))
   requires(!detail::Comparable<C, decltype(k), K>)
 {
   return c.erase(K(k));
 }
 
-template <int = 0, typename K, typename V, class C>
-inline auto erase(map<K, V, C>& c, auto const& k)
+template <int = 0, typename K, typename V, class C, class A, node_policy P,
+  class M>
+inline auto erase(map<K, V, C, A, P, M>& c, auto const& k)
   noexcept(noexcept(c.erase(k)))
   requires(detail::Comparable<C, decltype(k), K>)
 {
   return c.erase(k);
 }
 
-template <typename K, typename V, class C>
-inline auto erase(map<K, V, C>& c, K const k)
+template <typename K, typename V, class C, class A, node_policy P,
+  class M>
+inline auto erase(map<K, V, C, A, P, M>& c, K const k)
   noexcept(noexcept(erase<0>(c, k)))
 {
   return erase<0>(c, k);
 }
 
-template <typename K, typename V, class C>
-inline auto erase_if(map<K, V, C>& c, auto pred)
-  noexcept(noexcept(pred(std::declval<K const&>()), c.erase(c.begin())))
+template <typename K, typename V, class C, class A, node_policy P,
+  class M>
+inline auto erase_if(map<K, V, C, A, P, M>& c, auto pred)
+  noexcept(noexcept(c.erase_if(pred)))
 {
-  typename std::remove_reference_t<decltype(c)>::size_type r{};
-
-  for (auto i(c.begin()); i; pred(*i) ? ++r, i = c.erase(i) : ++i);
-
-  return r;
+  return c.erase_if(pred);
 }
 
 //////////////////////////////////////////////////////////////////////////////
-template <typename K, typename V, class C>
-inline void swap(map<K, V, C>& l, decltype(l) r) noexcept { l.swap(r); }
+template <typename K, typename V, class C, class A, node_policy P,
+  class M>
+inline void swap(map<K, V, C, A, P, M>& l, decltype(l) r) noexcept
+{
+  l.swap(r);
+}
+
+namespace pmr
+{
+
+template <typename Key, typename Value,
+  class Compare = std::compare_three_way, class Alpha = std::ratio<2, 3>,
+  node_policy Policy = plain_nodes>
+using map = sg::map<Key, Value, Compare, Alpha, Policy,
+  std::pmr::polymorphic_allocator<std::pair<Key const, Value>>>;
+
+}
 
 }
 
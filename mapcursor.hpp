@@ -0,0 +1,88 @@
+#ifndef SG_MAPCURSOR_HPP
+# define SG_MAPCURSOR_HPP
+# pragma once
+
+#include <iterator>
+
+#include <type_traits>
+
+namespace sg
+{
+
+template <typename T>
+class mapcursor
+{ // carries its ancestors, ++ and -- never compare keys
+  using cursor_t = mapcursor<std::remove_const_t<T>>;
+  friend mapcursor<T const>;
+
+  using node_t = std::remove_const_t<T>;
+
+public:
+  using iterator_category = std::bidirectional_iterator_tag;
+  using difference_type = detail::difference_type;
+  using value_type = std::conditional_t<
+      std::is_const_v<T>,
+      typename T::value_type const,
+      typename T::value_type
+    >;
+
+  using pointer = value_type*;
+  using reference = value_type&;
+
+private:
+  detail::path<node_t> p_;
+  node_t* const* r_;
+
+public:
+  mapcursor() = default;
+
+  mapcursor(node_t* const* const r, detail::path<node_t> const& p = {})
+    noexcept:
+    p_(p),
+    r_(r)
+  {
+  }
+
+  mapcursor(mapcursor const&) = default;
+  mapcursor(mapcursor&&) = default;
+
+  mapcursor(cursor_t const& o) noexcept requires(std::is_const_v<T>):
+    p_(o.p_),
+    r_(o.r_)
+  {
+  }
+
+  //
+  mapcursor& operator=(mapcursor const&) = default;
+  mapcursor& operator=(mapcursor&&) = default;
+
+  bool operator==(mapcursor const& o) const noexcept
+  {
+    return p_.top() == o.p_.top();
+  }
+
+  // increment, decrement
+  auto& operator++() noexcept { p_.next(); return *this; }
+  auto& operator--() noexcept { p_.prev(*r_); return *this; }
+
+  auto operator++(int) noexcept { auto const r(*this); ++*this; return r; }
+  auto operator--(int) noexcept { auto const r(*this); --*this; return r; }
+
+  // member access
+  auto operator->() const noexcept
+  {
+    return &static_cast<T*>(p_.top())->kv_;
+  }
+
+  auto& operator*() const noexcept { return static_cast<T*>(p_.top())->kv_; }
+
+  //
+  auto n() const noexcept { return p_.top(); }
+
+  //
+  explicit operator bool() const noexcept { return p_.top(); }
+};
+
+}
+
+#endif // SG_MAPCURSOR_HPP
@@ -15,8 +15,7 @@ class mapiterator
   using iterator_t = mapiterator<std::remove_const_t<T>>;
   friend mapiterator<T const>;
 
-  T* n_;
-  T* const* r_;
+  using node_t = std::remove_const_t<T>;
 
 public:
   using iterator_category = std::bidirectional_iterator_tag;
@@ -30,10 +29,14 @@ public:
   using pointer = value_type*;
   using reference = value_type&;
 
+private:
+  node_t* n_;
+  node_t* const* r_;
+
 public:
   mapiterator() = default;
 
-  mapiterator(T* const* const r, T* const n = {}) noexcept:
+  mapiterator(node_t* const* const r, node_t* const n = {}) noexcept:
     n_(n),
     r_(r)
   {
@@ -75,7 +78,7 @@ public:
 
   mapiterator operator++(int) noexcept
   {
-    auto const n(n_); n_ = detail::next_node(*r_, n_); return {n, r_};
+    auto const n(n_); n_ = detail::next_node(*r_, n_); return {r_, n};
   }
 
   mapiterator operator--(int) noexcept
@@ -84,12 +87,54 @@ public:
 
     n_ = n_ ? detail::prev_node(*r_, n_) : detail::last_node(*r_);
 
-    return {n, r_};
+    return {r_, n};
+  }
+
+  // O(log n) random access, with subtree counts
+  auto& operator+=(difference_type const k) noexcept
+    requires(detail::Counted<node_t*>)
+  {
+    n_ = std::get<0>(detail::select(*r_, detail::position(*r_, n_) + k));
+
+    return *this;
+  }
+
+  auto& operator-=(difference_type const k) noexcept
+    requires(detail::Counted<node_t*>)
+  {
+    return *this += -k;
+  }
+
+  friend mapiterator operator+(mapiterator i, difference_type const k)
+    noexcept requires(detail::Counted<node_t*>)
+  {
+    return i += k;
+  }
+
+  friend mapiterator operator+(difference_type const k, mapiterator i)
+    noexcept requires(detail::Counted<node_t*>)
+  {
+    return i += k;
+  }
+
+  friend mapiterator operator-(mapiterator i, difference_type const k)
+    noexcept requires(detail::Counted<node_t*>)
+  {
+    return i -= k;
+  }
+
+  friend difference_type operator-(mapiterator const& a, mapiterator const& b)
+    noexcept requires(detail::Counted<node_t*>)
+  {
+    return detail::position(*a.r_, a.n_) - detail::position(*b.r_, b.n_);
   }
 
   // member access
-  auto operator->() const noexcept { return &n_->kv_; }
-  auto& operator*() const noexcept { return n_->kv_; }
+  auto operator->() const noexcept { return &static_cast<T*>(n_)->kv_; }
+  auto& operator*() const noexcept { return static_cast<T*>(n_)->kv_; }
+
+  //
+  auto n() const noexcept { return n_; }
 
   //
   explicit operator bool() const noexcept { return n_; }
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <list>
 
 #include "multimap.hpp"
 
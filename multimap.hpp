@@ -4,13 +4,16 @@
 
 #include "utils.hpp"
 
+#include "multimapcursor.hpp"
 #include "multimapiterator.hpp"
 
 namespace sg
 {
 
 template <typename Key, typename Value,
-  class Compare = std::compare_three_way>
+  class Compare = std::compare_three_way, class Alpha = std::ratio<2, 3>,
+  node_policy Policy = plain_nodes,
+  class Allocator = std::allocator<std::pair<Key const, Value>>>
 class multimap
 {
 public:
@@ -19,6 +22,7 @@ public:
   using key_type = Key;
   using mapped_type = Value;
   using value_type = std::pair<Key const, Value>;
+  using allocator_type = Allocator;
 
   using difference_type = detail::difference_type;
   using size_type = detail::size_type;
@@ -30,16 +34,27 @@ public:
   using iterator = multimapiterator<node>;
   using reverse_iterator = std::reverse_iterator<iterator>;
 
+  using cursor = multimapcursor<node>;
+  using const_cursor = multimapcursor<node const>;
+
   struct node
   {
     using value_type = multimap::value_type;
 
+    using alpha = Alpha;
+
     static constinit inline Compare const cmp;
 
-    node* l_{}, *r_{};
-    std::list<value_type> v_;
+    detail::link_t<node, Policy> l_{}, r_{};
+    [[no_unique_address]] detail::parent_t<node, Policy> p_{};
+    [[no_unique_address]] detail::count_t<Policy> c_{1};
+    [[no_unique_address]] detail::weight_t<Policy> w_{1};
+    detail::inline_bucket<value_type,
+      typename std::allocator_traits<Allocator>::template
+        rebind_alloc<value_type>> v_;
 
-    explicit node(auto&& k, auto&& ...a)
+    explicit node(std::allocator_arg_t, auto const& al, auto&& k,
+      auto&& ...a)
       noexcept(noexcept(
           v_.emplace_back(
             std::piecewise_construct_t{},
@@ -47,7 +62,8 @@ public:
             std::forward_as_tuple(std::forward<decltype(a)>(a)...)
           )
         )
-      )
+      ):
+      v_(al)
     {
       v_.emplace_back(
         std::piecewise_construct_t{},
@@ -56,26 +72,23 @@ public:
       );
     }
 
-    ~node() noexcept(std::is_nothrow_destructible_v<decltype(v_)>)
-    {
-      delete l_; delete r_;
-    }
-
     //
     auto& key() const noexcept { return std::get<0>(v_.front()); }
 
     //
-    static auto emplace(auto& r, auto&& k, auto&& ...a)
-      noexcept(noexcept(new node(std::forward<decltype(k)>(k),
-        std::forward<decltype(a)>(a)...)))
+    static auto emplace(auto& al, auto& r, size_type const sz,
+      auto&& k, auto&& ...a)
+      noexcept(noexcept(detail::create_node(al,
+        std::forward<decltype(k)>(k), std::forward<decltype(a)>(a)...)))
       requires(detail::Comparable<Compare, decltype(k), key_type>)
     {
-      auto const [q, s](detail::emplace(r, k, [&]()
-          noexcept(noexcept(new node(
+      auto const [q, s](detail::emplace(r, sz, k, [&]()
+          noexcept(noexcept(detail::create_node(al,
             std::forward<decltype(k)>(k),
             std::forward<decltype(a)>(a)...)))
           {
-            return new node(
+            return detail::create_node(
+                al,
                 std::forward<decltype(k)>(k),
                 std::forward<decltype(a)>(a)...
               );
@@ -84,175 +97,155 @@ public:
       );
 
       if (!s)
+      {
         q->v_.emplace_back(
           std::piecewise_construct_t{},
           std::forward_as_tuple(std::forward<decltype(k)>(k)),
           std::forward_as_tuple(std::forward<decltype(a)>(a)...)
         );
+        detail::refresh(r, q);
+      }
+
+      return std::pair(q, s);
+    }
+
+    static auto emplace_hint(auto& al, auto& r, size_type const sz,
+      const_iterator const h, auto&& k, auto&& ...a)
+      noexcept(noexcept(detail::create_node(al,
+        std::forward<decltype(k)>(k), std::forward<decltype(a)>(a)...)))
+      requires(detail::Comparable<Compare, decltype(k), key_type>)
+    {
+      auto const [q, s](detail::emplace_hint(r, sz, h.n(), k, [&]()
+          noexcept(noexcept(detail::create_node(al,
+            std::forward<decltype(k)>(k),
+            std::forward<decltype(a)>(a)...)))
+          {
+            return detail::create_node(
+                al,
+                std::forward<decltype(k)>(k),
+                std::forward<decltype(a)>(a)...
+              );
+          }
+        )
+      );
+
+      if (s) return std::pair(iterator(&r, q), s);
 
-      return q;
+      // as close as possible to just before the hint
+      auto const i(q->v_.emplace(q == h.n() ? h.i() :
+        !h.n() || (cmp(q->key(), h.n()->key()) < 0) ?
+          q->v_.cend() : q->v_.cbegin(),
+        std::piecewise_construct_t{},
+        std::forward_as_tuple(std::forward<decltype(k)>(k)),
+        std::forward_as_tuple(std::forward<decltype(a)>(a)...)));
+      detail::refresh(r, q);
+
+      return std::pair(iterator(&r, q, i), s);
     }
 
-    static iterator erase(auto& r, const_iterator const i)
+    static iterator erase(auto& al, auto& r, const_iterator const i)
     {
       if (auto const n(i.n()); 1 == n->v_.size())
       {
-        return {&r, std::get<0>(node::erase(r, n->key()))};
+        auto const [q, p](detail::node_slot(r, n));
+
+        return {&r, std::get<0>(detail::erase(al, r, q, p))};
       }
-      else if (auto const it(i.iterator()); std::next(it) == n->v_.end())
+      else if (auto const it(i.i()); std::next(it) == n->v_.end())
       {
         auto const nn(std::next(i).n());
 
         n->v_.erase(it);
+        detail::refresh(r, n);
 
         return {&r, nn};
       }
       else
       {
-        return {&r, n, n->v_.erase(it)};
+        auto const j(n->v_.erase(it));
+        detail::refresh(r, n);
+
+        return {&r, n, j};
       }
     }
 
-    static auto erase(auto& r0, auto&& k)
+    static size_type erase(auto& al, auto& r0, auto const& k)
     {
-      using pointer = std::remove_cvref_t<decltype(r0)>;
-      using node = std::remove_pointer_t<pointer>;
-
-      if (r0)
+      if (auto const [q, p](detail::find_slot(r0, k)); q.get())
       {
-        for (auto q(&r0);;)
-        {
-          auto const n(*q);
+        auto const s(q.get()->v_.size());
+        detail::erase<false>(al, r0, q, p);
 
-          if (auto const c(node::cmp(k, n->key())); c < 0)
-          {
-            q = &n->l_;
-          }
-          else if (c > 0)
-          {
-            q = &n->r_;
-          }
-          else
-          {
-            auto const nxt(detail::next_node(r0, n));
-            auto const s(n->v_.size());
-
-            if (auto const l(n->l_), r(n->r_); l && r)
-            {
-              if (detail::size(l) < detail::size(r))
-              {
-                auto const [fnn, fnp](detail::first_node2(r, n));
-
-                *q = fnn;
-                fnn->l_ = l;
-
-                if (r != fnn)
-                {
-                  fnp->l_ = fnn->r_;
-                  fnn->r_ = r;
-                }
-              }
-              else
-              {
-                auto const [lnn, lnp](detail::last_node2(l, n));
-
-                *q = lnn;
-                lnn->r_ = r;
-
-                if (l != lnn)
-                {
-                  lnp->r_ = lnn->l_;
-                  lnn->l_ = l;
-                }
-              }
-            }
-            else
-            {
-              *q = l ? l : r;
-            }
-
-            n->l_ = n->r_ = {};
-            delete n;
-
-            return std::pair(nxt, s);
-          }
-        }
+        return s;
       }
 
-      return std::pair(pointer{}, decltype(r0->v_.size()){});
+      return {};
     }
   };
 
 private:
   using this_class = multimap;
+  using node_allocator = detail::node_allocator_t<node, Allocator, Policy>;
+
+  [[no_unique_address]] node_allocator a_;
   node* root_{};
+  size_type nn_{}, sz_{}, mx_{}; // mx_: most nodes since the last full rebuild
 
 public:
   multimap() = default;
 
+  explicit multimap(Allocator const& a) noexcept: a_(a) { }
+
   multimap(multimap const& o)
-    noexcept(noexcept(insert(o.begin(), o.end())))
-    requires(std::is_copy_constructible_v<value_type>)
+    requires(std::is_copy_constructible_v<value_type>):
+    a_(std::allocator_traits<node_allocator>::
+      select_on_container_copy_construction(o.a_))
   {
-    insert(o.begin(), o.end());
+    insert_sorted(o.begin(), o.end());
   }
 
-  multimap(multimap&& o)
-    noexcept(noexcept(*this = std::move(o)))
+  multimap(multimap&& o) noexcept: a_(std::move(o.a_))
   {
-    *this = std::move(o);
+    detail::assign(root_, nn_, sz_, mx_, o.root_, o.nn_, o.sz_, o.mx_)(
+      o.root_, o.nn_, o.sz_, o.mx_, nullptr, 0u, 0u, 0u);
   }
 
-  multimap(std::input_iterator auto const i, decltype(i) j)
-    noexcept(noexcept(insert(i, j)))
+  multimap(std::input_iterator auto const i, decltype(i) j,
+    Allocator const& a = Allocator()):
+    a_(a)
   {
-    insert(i, j);
+    insert_sorted(i, j);
   }
 
-  multimap(std::initializer_list<value_type> l)
-    noexcept(noexcept(*this = l))
+  multimap(std::initializer_list<value_type> l,
+    Allocator const& a = Allocator())
+    noexcept(noexcept(multimap(l.begin(), l.end(), a))):
+    multimap(l.begin(), l.end(), a)
   {
-    insert(l.begin(), l.end());
   }
 
-  ~multimap() noexcept(noexcept(delete root_)) { delete root_; }
+  ~multimap() noexcept(noexcept(delete root_)) { detail::destroy(a_, root_); }
 
 # include "common.hpp"
 
-  //
-  auto size() const noexcept
-  {
-    static constinit auto const f(
-      [](auto&& f, auto const n) noexcept -> decltype(n->v_.size())
-      {
-        return n ? n->v_.size() + f(f, n->l_) + f(f, n->r_) : 0;
-      }
-    );
-
-    return f(f, root_);
-  }
-
   //
   template <int = 0>
   auto count(auto const& k) const noexcept
     requires(detail::Comparable<Compare, decltype(k), key_type>)
   {
-    if (auto n(root_); n)
+    for (auto n(root_); n;)
     {
-      for (;;)
+      if (auto const c(node::cmp(k, n->key())); c < 0)
       {
-        if (auto const c(node::cmp(k, n->key())); c < 0)
-        {
-          n = detail::left_node(n);
-        }
-        else if (c > 0)
-        {
-          n = detail::right_node(n);
-        }
-        else
-        {
-          return n->v_.size();
-        }
+        n = detail::left_node(n);
+      }
+      else if (c > 0)
+      {
+        n = detail::right_node(n);
+      }
+      else
+      {
+        return n->v_.size();
       }
     }
 
@@ -266,21 +259,65 @@ public:
   iterator emplace(auto&& k, auto&& ...a)
     noexcept(noexcept(
         node::emplace(
+          a_,
           root_,
+          nn_,
           std::forward<decltype(k)>(k),
           std::forward<decltype(a)>(a)...
         )
       )
     )
   {
-    return {
-        &root_,
-        node::emplace(
+    auto const [n, s](
+      node::emplace(
+        a_,
+        root_,
+        nn_,
+        std::forward<decltype(k)>(k),
+        std::forward<decltype(a)>(a)...
+      )
+    );
+
+    detail::assign(nn_, sz_)(nn_ + s, sz_ + 1);
+
+    return {&root_, n};
+  }
+
+  template <int = 0>
+  iterator emplace_hint(const_iterator const h, auto&& k, auto&& ...a)
+    noexcept(noexcept(
+        node::emplace_hint(
+          a_,
           root_,
+          nn_,
+          h,
           std::forward<decltype(k)>(k),
           std::forward<decltype(a)>(a)...
         )
-      };
+      )
+    )
+  {
+    auto const [i, s](
+      node::emplace_hint(
+        a_,
+        root_,
+        nn_,
+        h,
+        std::forward<decltype(k)>(k),
+        std::forward<decltype(a)>(a)...
+      )
+    );
+
+    detail::assign(nn_, sz_)(nn_ + s, sz_ + 1);
+
+    return i;
+  }
+
+  auto emplace_hint(const_iterator const h, key_type k, auto&& ...a)
+    noexcept(noexcept(
+      emplace_hint<0>(h, std::move(k), std::forward<decltype(a)>(a)...)))
+  {
+    return emplace_hint<0>(h, std::move(k), std::forward<decltype(a)>(a)...);
   }
 
   auto emplace(key_type k, auto&& ...a)
@@ -319,13 +356,48 @@ public:
     return equal_range<0>(std::move(k));
   }
 
+  template <int = 0>
+  std::span<value_type> equal_span(auto const& k) noexcept
+    requires(detail::Comparable<Compare, decltype(k), key_type>)
+  { // the elements equal_range(k) spans, buckets are contiguous
+    if (auto const n(detail::find(root_, k)); n)
+    {
+      return {n->v_.data(), n->v_.size()};
+    }
+
+    return {};
+  }
+
+  auto equal_span(key_type const k) noexcept { return equal_span<0>(k); }
+
+  template <int = 0>
+  std::span<value_type const> equal_span(auto const& k) const noexcept
+    requires(detail::Comparable<Compare, decltype(k), key_type>)
+  {
+    if (auto const n(detail::find(root_, k)); n)
+    {
+      return {n->v_.data(), n->v_.size()};
+    }
+
+    return {};
+  }
+
+  auto equal_span(key_type const k) const noexcept
+  {
+    return equal_span<0>(k);
+  }
+
   //
   template <int = 0>
   auto erase(auto&& k)
-    noexcept(noexcept(node::erase(root_, k)))
+    noexcept(noexcept(node::erase(a_, root_, k)))
     requires(!std::convertible_to<decltype(k), const_iterator>)
   {
-    return std::get<1>(node::erase(root_, k));
+    auto const s(node::erase(a_, root_, k));
+    detail::assign(nn_, sz_)(nn_ - bool(s), sz_ - s);
+    detail::compact(root_, nn_, mx_, bool(s));
+
+    return s;
   }
 
   auto erase(key_type k) noexcept(noexcept(erase<0>(std::move(k))))
@@ -334,31 +406,41 @@ public:
   }
 
   iterator erase(const_iterator const i)
-    noexcept(noexcept(node::erase(root_, i)))
+    noexcept(noexcept(node::erase(a_, root_, i)))
   {
-    return node::erase(root_, i);
+    auto const e(1 == i.n()->v_.size());
+    auto const r(node::erase(a_, root_, i));
+
+    detail::assign(nn_, sz_)(nn_ - e, sz_ - 1);
+    detail::compact(root_, nn_, mx_, e);
+
+    return r;
   }
 
   //
   iterator insert(value_type const& v)
-    noexcept(noexcept(node::emplace(root_, std::get<0>(v), std::get<1>(v))))
+    noexcept(noexcept(emplace(std::get<0>(v), std::get<1>(v))))
   {
-    return {
-        &root_,
-        node::emplace(root_, std::get<0>(v), std::get<1>(v))
-      };
+    return emplace(std::get<0>(v), std::get<1>(v));
   }
 
   iterator insert(value_type&& v)
+    noexcept(noexcept(emplace(std::get<0>(v), std::move(std::get<1>(v)))))
+  {
+    return emplace(std::get<0>(v), std::move(std::get<1>(v)));
+  }
+
+  iterator insert(const_iterator const h, value_type const& v)
+    noexcept(noexcept(emplace_hint(h, std::get<0>(v), std::get<1>(v))))
+  {
+    return emplace_hint(h, std::get<0>(v), std::get<1>(v));
+  }
+
+  iterator insert(const_iterator const h, value_type&& v)
     noexcept(noexcept(
-        node::emplace(root_, std::get<0>(v), std::move(std::get<1>(v)))
-      )
-    )
+      emplace_hint(h, std::get<0>(v), std::move(std::get<1>(v)))))
   {
-    return {
-        &root_,
-        node::emplace(root_, std::get<0>(v), std::move(std::get<1>(v)))
-      };
+    return emplace_hint(h, std::get<0>(v), std::move(std::get<1>(v)));
   }
 
   void insert(std::input_iterator auto const i, decltype(i) j)
@@ -386,43 +468,58 @@ public:
 };
 
 //////////////////////////////////////////////////////////////////////////////
-template <int = 0, typename K, typename V, class C>
-inline auto erase(multimap<K, V, C>& c, auto const& k)
+template <int = 0, typename K, typename V, class C, class A, node_policy P,
+  class M>
+inline auto erase(multimap<K, V, C, A, P, M>& c, auto const& k)
   noexcept(noexcept(c.erase(K(k))))
   requires(!detail::Comparable<C, decltype(k), K>)
 {
   return c.erase(K(k));
 }
 
-template <int = 0, typename K, typename V, class C>
-inline auto erase(multimap<K, V, C>& c, auto const& k)
+template <int = 0, typename K, typename V, class C, class A, node_policy P,
+  class M>
+inline auto erase(multimap<K, V, C, A, P, M>& c, auto const& k)
   noexcept(noexcept(c.erase(k)))
   requires(detail::Comparable<C, decltype(k), K>)
 {
   return c.erase(k);
 }
 
-template <typename K, typename V, class C>
-inline auto erase(multimap<K, V, C>& c, K const k)
+template <typename K, typename V, class C, class A, node_policy P,
+  class M>
+inline auto erase(multimap<K, V, C, A, P, M>& c, K const k)
   noexcept(noexcept(erase<0>(c, k)))
 {
   return erase<0>(c, k);
 }
 
-template <typename K, typename V, class C>
-inline auto erase_if(multimap<K, V, C>& c, auto pred)
-  noexcept(noexcept(c.erase(c.begin())))
+template <typename K, typename V, class C, class A, node_policy P,
+  class M>
+inline auto erase_if(multimap<K, V, C, A, P, M>& c, auto pred)
+  noexcept(noexcept(c.erase_if(pred)))
 {
-  typename std::remove_reference_t<decltype(c)>::size_type r{};
-
-  for (auto i(c.begin()); i; pred(*i) ? ++r, i = c.erase(i) : ++i);
-
-  return r;
+  return c.erase_if(pred);
 }
 
 //////////////////////////////////////////////////////////////////////////////
-template <typename K, typename V, class C>
-inline void swap(multimap<K, V, C>& l, decltype(l) r) noexcept { l.swap(r); }
+template <typename K, typename V, class C, class A, node_policy P,
+  class M>
+inline void swap(multimap<K, V, C, A, P, M>& l, decltype(l) r) noexcept
+{
+  l.swap(r);
+}
+
+namespace pmr
+{
+
+template <typename Key, typename Value,
+  class Compare = std::compare_three_way, class Alpha = std::ratio<2, 3>,
+  node_policy Policy = plain_nodes>
+using multimap = sg::multimap<Key, Value, Compare, Alpha, Policy,
+  std::pmr::polymorphic_allocator<std::pair<Key const, Value>>>;
+
+}
 
 }
 
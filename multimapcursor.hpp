@@ -0,0 +1,133 @@
+#ifndef SG_MULTIMAPCURSOR_HPP
+# define SG_MULTIMAPCURSOR_HPP
+# pragma once
+
+#include <type_traits>
+#include <utility>
+
+namespace sg
+{
+
+template <typename T>
+class multimapcursor
+{ // carries its ancestors, ++ and -- never compare keys
+  using inverse_const_t = std::conditional_t<
+    std::is_const_v<T>,
+    multimapcursor<std::remove_const_t<T>>,
+    multimapcursor<T const>
+  >;
+
+  friend inverse_const_t;
+
+  using node_t = std::remove_const_t<T>;
+
+public:
+  using iterator_category = std::bidirectional_iterator_tag;
+  using difference_type = detail::difference_type;
+  using value_type = std::conditional_t<
+    std::is_const_v<T>,
+    typename T::value_type const,
+    typename T::value_type
+  >;
+
+  using pointer = value_type*;
+  using reference = value_type&;
+
+private:
+  detail::path<node_t> p_;
+  decltype(std::declval<T&>().v_.begin()) i_;
+  node_t* const* r_;
+
+public:
+  multimapcursor() = default;
+
+  multimapcursor(node_t* const* const r, detail::path<node_t> const& p = {})
+    noexcept:
+    p_(p),
+    i_(),
+    r_(r)
+  {
+    if (auto const n(p_.top()); n)
+    {
+      if constexpr(std::is_const_v<T>)
+      {
+        i_ = n->v_.cbegin();
+      }
+      else
+      {
+        i_ = n->v_.begin();
+      }
+    }
+  }
+
+  multimapcursor(multimapcursor const&) = default;
+  multimapcursor(multimapcursor&&) = default;
+
+  multimapcursor(inverse_const_t const& o) noexcept
+    requires(std::is_const_v<T>):
+    p_(o.p_),
+    i_(o.i_),
+    r_(o.r_)
+  {
+  }
+
+  //
+  multimapcursor& operator=(multimapcursor const&) = default;
+  multimapcursor& operator=(multimapcursor&&) = default;
+
+  bool operator==(multimapcursor const& o) const noexcept
+  {
+    return (p_.top() == o.p_.top()) && (i_ == o.i_);
+  }
+
+  // increment, decrement
+  auto& operator++() noexcept
+  {
+    if (i_ = std::next(i_); p_.top()->v_.end() == i_)
+    {
+      p_.next();
+
+      auto const n(p_.top());
+      i_ = n ? n->v_.begin() : decltype(i_){};
+    }
+
+    return *this;
+  }
+
+  auto& operator--() noexcept
+  {
+    if (auto const n(p_.top()); !n || (n->v_.begin() == i_))
+    {
+      p_.prev(*r_);
+
+      if (auto const n(p_.top()); n)
+      {
+        i_ = std::prev(n->v_.end());
+      }
+    }
+    else
+    {
+      i_ = std::prev(i_);
+    }
+
+    return *this;
+  }
+
+  auto operator++(int) noexcept { auto const r(*this); ++*this; return r; }
+  auto operator--(int) noexcept { auto const r(*this); --*this; return r; }
+
+  // member access
+  auto& operator->() const noexcept { return i_; }
+  auto& operator*() const noexcept { return *i_; }
+
+  //
+  auto& i() const noexcept { return i_; }
+  auto n() const noexcept { return p_.top(); }
+
+  //
+  explicit operator bool() const noexcept { return p_.top(); }
+};
+
+}
+
+#endif // SG_MULTIMAPCURSOR_HPP
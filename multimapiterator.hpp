@@ -2,9 +2,8 @@
 # define SG_MULTIMAPITERATOR_HPP
 # pragma once
 
-#include <list>
-
 #include <type_traits>
+#include <utility>
 
 namespace sg
 {
@@ -36,11 +35,7 @@ public:
 
 private:
   node_t* n_;
-  std::conditional_t<
-    std::is_const_v<T>,
-    typename std::list<std::remove_const_t<value_type>>::const_iterator,
-    typename std::list<std::remove_const_t<value_type>>::iterator
-  > i_;
+  decltype(std::declval<T&>().v_.begin()) i_;
   node_t* const* r_;
 
 public:
@@ -137,10 +132,60 @@ public:
   auto operator++(int) noexcept { auto const r(*this); ++*this; return r; }
   auto operator--(int) noexcept { auto const r(*this); --*this; return r; }
 
+  // O(log n) random access, with subtree counts
+  auto& operator+=(difference_type const k) noexcept
+    requires(detail::Counted<node_t*>)
+  {
+    auto const [n, i](detail::select(*r_, position() + k));
+
+    if ((n_ = n)) i_ = std::next(decltype(i_)(n->v_.begin()), i);
+    else i_ = {};
+
+    return *this;
+  }
+
+  auto& operator-=(difference_type const k) noexcept
+    requires(detail::Counted<node_t*>)
+  {
+    return *this += -k;
+  }
+
+  friend multimapiterator operator+(multimapiterator i,
+    difference_type const k) noexcept requires(detail::Counted<node_t*>)
+  {
+    return i += k;
+  }
+
+  friend multimapiterator operator+(difference_type const k,
+    multimapiterator i) noexcept requires(detail::Counted<node_t*>)
+  {
+    return i += k;
+  }
+
+  friend multimapiterator operator-(multimapiterator i,
+    difference_type const k) noexcept requires(detail::Counted<node_t*>)
+  {
+    return i -= k;
+  }
+
+  friend difference_type operator-(multimapiterator const& a,
+    multimapiterator const& b) noexcept requires(detail::Counted<node_t*>)
+  {
+    return a.position() - b.position();
+  }
+
   // member access
   auto& operator->() const noexcept { return i_; }
   auto& operator*() const noexcept { return *i_; }
 
+  //
+  detail::size_type position() const noexcept
+    requires(detail::Counted<node_t*>)
+  { // the rank of the element pointed to
+    return detail::position(*r_, n_) + (n_ ?
+      std::distance(decltype(i_)(n_->v_.begin()), i_) : 0);
+  }
+
   //
   auto& i() const noexcept { return i_; }
   auto n() const noexcept { return n_; }
@@ -4,12 +4,15 @@
 
 #include "utils.hpp"
 
+#include "multimapcursor.hpp"
 #include "multimapiterator.hpp"
 
 namespace sg
 {
 
-template <typename Key, class Compare = std::compare_three_way>
+template <typename Key, class Compare = std::compare_three_way,
+  class Alpha = std::ratio<2, 3>, node_policy Policy = plain_nodes,
+  class Allocator = std::allocator<Key>>
 class multiset
 {
 public:
@@ -17,6 +20,7 @@ public:
 
   using key_type = Key;
   using value_type = Key;
+  using allocator_type = Allocator;
 
   using difference_type = detail::difference_type;
   using size_type = detail::size_type;
@@ -28,216 +32,214 @@ public:
   using const_iterator = multimapiterator<node const>;
   using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
+  using cursor = multimapcursor<node const>;
+  using const_cursor = multimapcursor<node const>;
+
   struct node
   {
     using value_type = multiset::value_type;
 
+    using alpha = Alpha;
+
     static constinit inline Compare const cmp;
 
-    node* l_{}, *r_{};
-    std::list<value_type> v_;
+    detail::link_t<node, Policy> l_{}, r_{};
+    [[no_unique_address]] detail::parent_t<node, Policy> p_{};
+    [[no_unique_address]] detail::count_t<Policy> c_{1};
+    [[no_unique_address]] detail::weight_t<Policy> w_{1};
+    detail::bucket_t<value_type, Allocator, Policy> v_;
 
-    explicit node(auto&& k)
+    explicit node(std::allocator_arg_t, auto const& al, auto&& k)
       noexcept(noexcept(v_.emplace_back(std::forward<decltype(k)>(k))))
+      requires(!(Policy & counted_duplicates)):
+      v_(al)
     {
       v_.emplace_back(std::forward<decltype(k)>(k));
     }
 
-    ~node() noexcept(std::is_nothrow_destructible_v<decltype(v_)>)
+    explicit node(auto&& k)
+      noexcept(noexcept(decltype(v_)(std::forward<decltype(k)>(k))))
+      requires(bool(Policy & counted_duplicates)):
+      v_(std::forward<decltype(k)>(k))
     {
-      delete l_; delete r_;
     }
 
     //
     auto& key() const noexcept { return v_.front(); }
 
     //
-    static auto emplace(auto& r, auto&& k)
-      noexcept(noexcept(new node(std::forward<decltype(k)>(k))))
+    static auto emplace(auto& al, auto& r, size_type const sz, auto&& k)
+      noexcept(noexcept(detail::create_node(al,
+        std::forward<decltype(k)>(k))))
+      requires(detail::Comparable<Compare, decltype(k), key_type>)
+    {
+      auto const [q, s](detail::emplace(r, sz, k, [&]()
+          noexcept(noexcept(detail::create_node(al,
+        std::forward<decltype(k)>(k))))
+          {
+            return detail::create_node(al, std::forward<decltype(k)>(k));
+          }
+        )
+      );
+
+      if (!s)
+      {
+        q->v_.emplace_back(std::forward<decltype(k)>(k));
+        detail::refresh(r, q);
+      }
+
+      return std::pair(q, s);
+    }
+
+    static auto emplace(auto& al, auto& r, size_type const sz, auto&& ...a)
+      noexcept(noexcept(node::emplace(al, r, sz,
+        key_type(std::forward<decltype(a)>(a)...))))
+      requires(std::is_constructible_v<key_type, decltype(a)...>)
+    {
+      return node::emplace(al, r, sz,
+        key_type(std::forward<decltype(a)>(a)...));
+    }
+
+    static auto emplace_hint(auto& al, auto& r, size_type const sz,
+      const_iterator const h, auto&& k)
+      noexcept(noexcept(detail::create_node(al,
+        std::forward<decltype(k)>(k))))
       requires(detail::Comparable<Compare, decltype(k), key_type>)
     {
-      auto const [q, s](detail::emplace(r, k, [&]()
-          noexcept(noexcept(new node(std::forward<decltype(k)>(k))))
+      auto const [q, s](detail::emplace_hint(r, sz, h.n(), k, [&]()
+          noexcept(noexcept(detail::create_node(al,
+        std::forward<decltype(k)>(k))))
           {
-            return new node(std::forward<decltype(k)>(k));
+            return detail::create_node(al, std::forward<decltype(k)>(k));
           }
         )
       );
 
-      if (!s) q->v_.emplace_back(std::forward<decltype(k)>(k));
+      if (s) return std::pair(iterator(&r, q), s);
 
-      return q;
+      // as close as possible to just before the hint
+      auto const i(q->v_.emplace(q == h.n() ? h.i() :
+        !h.n() || (cmp(q->key(), h.n()->key()) < 0) ?
+          q->v_.cend() : q->v_.cbegin(),
+        std::forward<decltype(k)>(k)));
+      detail::refresh(r, q);
+
+      return std::pair(iterator(&r, q, i), s);
     }
 
-    static auto emplace(auto& r, auto&& ...a)
-      noexcept(noexcept(node::emplace(r, std::forward<decltype(a)>(a)...)))
+    static auto emplace_hint(auto& al, auto& r, size_type const sz,
+      const_iterator const h, auto&& ...a)
+      noexcept(noexcept(node::emplace_hint(al, r, sz, h,
+        key_type(std::forward<decltype(a)>(a)...))))
       requires(std::is_constructible_v<key_type, decltype(a)...>)
     {
-      return node::emplace(r, std::forward<decltype(a)>(a)...);
+      return node::emplace_hint(al, r, sz, h,
+        key_type(std::forward<decltype(a)>(a)...));
     }
 
-    static iterator erase(auto& r0, const_iterator const i)
-      noexcept(noexcept(std::declval<node>().v_.erase(i.i()),
-        node::erase(r0, i.n(), i.p())))
+    static iterator erase(auto& al, auto& r0, const_iterator const i)
     {
       if (auto const n(i.n()); 1 == n->v_.size())
       {
-        return {&r0, std::get<0>(node::erase(r0, n->key()))};
+        auto const [q, p](detail::node_slot(r0, n));
+
+        return {&r0, std::get<0>(detail::erase(al, r0, q, p))};
       }
-      else if (auto const it(i.iterator()); std::next(it) == n->v_.end())
+      else if (auto const it(i.i()); std::next(it) == n->v_.end())
       {
         auto const nn(std::next(i).n());
 
         n->v_.erase(it);
+        detail::refresh(r0, n);
 
         return {&r0, nn};
       }
       else
       {
-        return {&r0, n, n->v_.erase(it)};
+        auto const j(n->v_.erase(it));
+        detail::refresh(r0, n);
+
+        return {&r0, n, j};
       }
     }
 
-    static auto erase(auto& r0, auto const& k)
+    static size_type erase(auto& al, auto& r0, auto const& k)
     {
-      using pointer = std::remove_cvref_t<decltype(r0)>;
-      using node = std::remove_pointer_t<pointer>;
-
-      if (r0)
+      if (auto const [q, p](detail::find_slot(r0, k)); q.get())
       {
-        for (auto q(&r0);;)
-        {
-          auto const n(*q);
+        auto const s(q.get()->v_.size());
+        detail::erase<false>(al, r0, q, p);
 
-          if (auto const c(node::cmp(k, n->key())); c < 0)
-          {
-            q = &n->l_;
-          }
-          else if (c > 0)
-          {
-            q = &n->r_;
-          }
-          else
-          {
-            auto const nxt(detail::next_node(r0, n));
-            auto const s(n->v_.size());
-
-            if (auto const l(n->l_), r(n->r_); l && r)
-            {
-              if (detail::size(l) < detail::size(r))
-              {
-                auto const [fnn, fnp](detail::first_node2(r, n));
-
-                *q = fnn;
-                fnn->l_ = l;
-
-                if (r != fnn)
-                {
-                  fnp->l_ = fnn->r_;
-                  fnn->r_ = r;
-                }
-              }
-              else
-              {
-                auto const [lnn, lnp](detail::last_node2(l, n));
-
-                *q = lnn;
-                lnn->r_ = r;
-
-                if (l != lnn)
-                {
-                  lnp->r_ = lnn->l_;
-                  lnn->l_ = l;
-                }
-              }
-            }
-            else
-            {
-              *q = l ? l : r;
-            }
-
-            n->l_ = n->r_ = {};
-            delete n;
-
-            return std::pair(nxt, s);
-          }
-        }
+        return s;
       }
 
-      return std::pair(pointer{}, decltype(r0->v_.size()){});
+      return {};
     }
   };
 
 private:
   using this_class = multiset;
+  using node_allocator = detail::node_allocator_t<node, Allocator, Policy>;
+
+  [[no_unique_address]] node_allocator a_;
   node* root_{};
+  size_type nn_{}, sz_{}, mx_{}; // mx_: most nodes since the last full rebuild
 
 public:
   multiset() = default;
 
+  explicit multiset(Allocator const& a) noexcept: a_(a) { }
+
   multiset(multiset const& o)
-    noexcept(noexcept(insert(o.begin(), o.end())))
-    requires(std::is_copy_constructible_v<value_type>)
+    requires(std::is_copy_constructible_v<value_type>):
+    a_(std::allocator_traits<node_allocator>::
+      select_on_container_copy_construction(o.a_))
   {
-    insert(o.begin(), o.end());
+    insert_sorted(o.begin(), o.end());
   }
 
-  multiset(multiset&& o)
-    noexcept(noexcept(*this = std::move(o)))
+  multiset(multiset&& o) noexcept: a_(std::move(o.a_))
   {
-    *this = std::move(o);
+    detail::assign(root_, nn_, sz_, mx_, o.root_, o.nn_, o.sz_, o.mx_)(
+      o.root_, o.nn_, o.sz_, o.mx_, nullptr, 0u, 0u, 0u);
   }
 
-  multiset(std::input_iterator auto const i, decltype(i) j)
-    noexcept(noexcept(insert(i, j)))
+  multiset(std::input_iterator auto const i, decltype(i) j,
+    Allocator const& a = Allocator()):
+    a_(a)
   {
-    insert(i, j);
+    insert_sorted(i, j);
   }
 
-  multiset(std::initializer_list<value_type> l)
-    noexcept(noexcept(insert(l.begin(), l.end())))
+  multiset(std::initializer_list<value_type> l,
+    Allocator const& a = Allocator())
+    noexcept(noexcept(multiset(l.begin(), l.end(), a))):
+    multiset(l.begin(), l.end(), a)
   {
-    insert(l.begin(), l.end());
   }
 
-  ~multiset() noexcept(noexcept(delete root_)) { delete root_; }
+  ~multiset() noexcept(noexcept(delete root_)) { detail::destroy(a_, root_); }
 
 # include "common.hpp"
 
-  //
-  auto size() const noexcept
-  {
-    static constinit auto const f(
-      [](auto&& f, auto const n) noexcept -> decltype(n->v_.size())
-      {
-        return n ? n->v_.size() + f(f, n->l_) + f(f, n->r_) : 0;
-      }
-    );
-
-    return f(f, root_);
-  }
-
   //
   template <int = 0>
   auto count(auto const& k) const noexcept
     requires(detail::Comparable<Compare, key_type, decltype(k)>)
   {
-    if (auto n(root_); n)
+    for (auto n(root_); n;)
     {
-      for (;;)
+      if (auto const c(node::cmp(k, n->key())); c < 0)
       {
-        if (auto const c(node::cmp(k, n->key())); c < 0)
-        {
-          n = detail::left_node(n);
-        }
-        else if (c > 0)
-        {
-          n = detail::right_node(n);
-        }
-        else
-        {
-          return n->v_.size();
-        }
+        n = detail::left_node(n);
+      }
+      else if (c > 0)
+      {
+        n = detail::right_node(n);
+      }
+      else
+      {
+        return n->v_.size();
       }
     }
 
@@ -248,9 +250,25 @@ public:
 
   //
   iterator emplace(auto&& ...a)
-    noexcept(noexcept(node::emplace(root_, std::forward<decltype(a)>(a)...)))
+    noexcept(noexcept(
+      node::emplace(a_, root_, nn_, std::forward<decltype(a)>(a)...)))
   {
-    return {&root_, node::emplace(root_, std::forward<decltype(a)>(a)...)};
+    auto const [n, s](
+      node::emplace(a_, root_, nn_, std::forward<decltype(a)>(a)...));
+    detail::assign(nn_, sz_)(nn_ + s, sz_ + 1);
+
+    return {&root_, n};
+  }
+
+  iterator emplace_hint(const_iterator const h, auto&& ...a)
+    noexcept(noexcept(
+      node::emplace_hint(a_, root_, nn_, h, std::forward<decltype(a)>(a)...)))
+  {
+    auto const [i, s](
+      node::emplace_hint(a_, root_, nn_, h, std::forward<decltype(a)>(a)...));
+    detail::assign(nn_, sz_)(nn_ + s, sz_ + 1);
+
+    return i;
   }
 
   //
@@ -280,13 +298,36 @@ public:
     return equal_range<0>(std::move(k));
   }
 
+  template <int = 0>
+  std::span<value_type const> equal_span(auto const& k) const noexcept
+    requires(detail::Comparable<Compare, decltype(k), key_type> &&
+      !(Policy & counted_duplicates))
+  { // the elements equal_range(k) spans, buckets are contiguous
+    if (auto const n(detail::find(root_, k)); n)
+    {
+      return {n->v_.data(), n->v_.size()};
+    }
+
+    return {};
+  }
+
+  auto equal_span(key_type const k) const noexcept
+    requires(!(Policy & counted_duplicates))
+  {
+    return equal_span<0>(k);
+  }
+
   //
   template <int = 0>
   auto erase(auto&& k)
-    noexcept(noexcept(node::erase(root_, k)))
+    noexcept(noexcept(node::erase(a_, root_, k)))
     requires(!std::convertible_to<decltype(k), const_iterator>)
   {
-    return std::get<1>(node::erase(root_, k));
+    auto const s(node::erase(a_, root_, k));
+    detail::assign(nn_, sz_)(nn_ - bool(s), sz_ - s);
+    detail::compact(root_, nn_, mx_, bool(s));
+
+    return s;
   }
 
   auto erase(key_type k) noexcept(noexcept(erase<0>(std::move(k))))
@@ -295,22 +336,38 @@ public:
   }
 
   iterator erase(const_iterator const i)
-    noexcept(noexcept(node::erase(root_, i)))
+    noexcept(noexcept(node::erase(a_, root_, i)))
   {
-    return node::erase(root_, i);
+    auto const e(1 == i.n()->v_.size());
+    auto const r(node::erase(a_, root_, i));
+
+    detail::assign(nn_, sz_)(nn_ - e, sz_ - 1);
+    detail::compact(root_, nn_, mx_, e);
+
+    return r;
   }
 
   //
-  iterator insert(value_type const& v)
-    noexcept(noexcept(node::emplace(root_, v)))
+  iterator insert(value_type const& v) noexcept(noexcept(emplace(v)))
+  {
+    return emplace(v);
+  }
+
+  iterator insert(value_type&& v) noexcept(noexcept(emplace(std::move(v))))
   {
-    return {&root_, node::emplace(root_, v)};
+    return emplace(std::move(v));
   }
 
-  iterator insert(value_type&& v)
-    noexcept(noexcept(node::emplace(root_, std::move(v))))
+  iterator insert(const_iterator const h, value_type const& v)
+    noexcept(noexcept(emplace_hint(h, v)))
   {
-    return {&root_, node::emplace(root_, std::move(v))};
+    return emplace_hint(h, v);
+  }
+
+  iterator insert(const_iterator const h, value_type&& v)
+    noexcept(noexcept(emplace_hint(h, std::move(v))))
+  {
+    return emplace_hint(h, std::move(v));
   }
 
   void insert(std::input_iterator auto const i, decltype(i) j)
@@ -328,43 +385,69 @@ public:
 };
 
 //////////////////////////////////////////////////////////////////////////////
-template <int = 0, typename K, class C>
-inline auto erase(multiset<K, C>& c, auto const& k)
+template <int = 0, typename K, class C, class A, node_policy P,
+  class M>
+inline auto erase(multiset<K, C, A, P, M>& c, auto const& k)
   noexcept(noexcept(c.erase(K(k))))
   requires(!detail::Comparable<C, decltype(k), K>)
 {
   return c.erase(K(k));
 }
 
-template <int = 0, typename K, class C>
-inline auto erase(multiset<K, C>& c, auto const& k)
+template <int = 0, typename K, class C, class A, node_policy P,
+  class M>
+inline auto erase(multiset<K, C, A, P, M>& c, auto const& k)
   noexcept(noexcept(c.erase(k)))
   requires(detail::Comparable<C, decltype(k), K>)
 {
   return c.erase(k);
 }
 
-template <typename K, class C>
-inline auto erase(multiset<K, C>& c, K const k)
+template <typename K, class C, class A, node_policy P,
+  class M>
+inline auto erase(multiset<K, C, A, P, M>& c, K const k)
   noexcept(noexcept(erase<0>(c, k)))
 {
   return erase<0>(c, k);
 }
 
-template <typename K, class C>
-inline auto erase_if(multiset<K, C>& c, auto pred)
-  noexcept(noexcept(c.erase(c.begin())))
+template <typename K, class C, class A, node_policy P,
+  class M>
+inline auto erase_if(multiset<K, C, A, P, M>& c, auto pred)
+  noexcept(noexcept(c.erase_if(pred)))
 {
-  typename std::remove_reference_t<decltype(c)>::size_type r{};
-
-  for (auto i(c.begin()); i; pred(*i) ? ++r, i = c.erase(i) : ++i);
-
-  return r;
+  return c.erase_if(pred);
 }
 
 //////////////////////////////////////////////////////////////////////////////
-template <typename K, class C>
-inline void swap(multiset<K, C>& l, decltype(l) r) noexcept { l.swap(r); }
+template <typename K, class C, class A, node_policy P,
+  class M>
+inline void swap(multiset<K, C, A, P, M>& l, decltype(l) r) noexcept
+{
+  l.swap(r);
+}
+
+// equal keys are indistinguishable, nodes count them instead of copying them
+template <typename Key, class Compare = std::compare_three_way,
+  class Alpha = std::ratio<2, 3>, node_policy Policy = plain_nodes,
+  class Allocator = std::allocator<Key>>
+using counted_multiset = multiset<Key, Compare, Alpha,
+  Policy | counted_duplicates, Allocator>;
+
+namespace pmr
+{
+
+template <typename Key, class Compare = std::compare_three_way,
+  class Alpha = std::ratio<2, 3>, node_policy Policy = plain_nodes>
+using multiset = sg::multiset<Key, Compare, Alpha, Policy,
+  std::pmr::polymorphic_allocator<Key>>;
+
+template <typename Key, class Compare = std::compare_three_way,
+  class Alpha = std::ratio<2, 3>, node_policy Policy = plain_nodes>
+using counted_multiset = sg::counted_multiset<Key, Compare, Alpha, Policy,
+  std::pmr::polymorphic_allocator<Key>>;
+
+}
 
 }
 
@@ -0,0 +1,149 @@
+#ifndef SG_OVERLAPITERATOR_HPP
+# define SG_OVERLAPITERATOR_HPP
+# pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+namespace sg
+{
+
+template <typename T>
+class overlapiterator
+{ // the elements of an intervalmap overlapping an interval, in iteration
+  // order, the pending ancestors are kept on a stack, subtrees whose
+  // intervals all end too early are skipped
+  using inverse_const_t = std::conditional_t<
+    std::is_const_v<T>,
+    overlapiterator<std::remove_const_t<T>>,
+    overlapiterator<T const>
+  >;
+
+  friend inverse_const_t;
+
+  using node_t = std::remove_const_t<T>;
+  using key_type = std::remove_const_t<
+    std::tuple_element_t<0, typename T::value_type>>;
+
+public:
+  using iterator_category = std::forward_iterator_tag;
+  using difference_type = detail::difference_type;
+  using value_type = std::conditional_t<
+    std::is_const_v<T>,
+    typename T::value_type const,
+    typename T::value_type
+  >;
+
+  using pointer = value_type*;
+  using reference = value_type&;
+
+private:
+  detail::path<node_t> p_;
+  node_t* n_{};
+  decltype(std::declval<T&>().v_.begin()) i_{};
+  key_type k_{};
+
+  void descend(node_t* n) noexcept
+  {
+    for (auto const& mink(std::get<0>(k_));
+      n && (node_t::cmp(mink, n->m_) < 0); n = detail::left_node(n))
+    {
+      p_.push(n);
+    }
+  }
+
+  void next() noexcept
+  { // the next node in order, holding an overlapping interval
+    auto const& [mink, maxk](k_);
+    auto const eq(node_t::cmp(mink, maxk) == 0);
+
+    for (node_t* n; (n = p_.top());)
+    {
+      p_.pop();
+
+      auto const c(node_t::cmp(maxk, n->key()));
+
+      if (c > 0) descend(detail::right_node(n));
+
+      if ((c > 0) || (eq && (c == 0)))
+      { // the intervals ending past mink end the bucket
+        auto& v(std::as_const(*n).v_);
+
+        if (auto const i(std::upper_bound(v.begin(), v.end(), mink,
+          [](auto& k, auto& e) noexcept
+          {
+            return node_t::cmp(k, node_t::end_of(e)) < 0;
+          })); v.end() != i)
+        {
+          n_ = n;
+          i_ = std::next(n->v_.begin(), i - v.begin());
+
+          return;
+        }
+      }
+    }
+
+    n_ = {}; i_ = {};
+  }
+
+public:
+  overlapiterator() = default;
+
+  overlapiterator(node_t* const r, key_type const& k)
+    noexcept(std::is_nothrow_copy_constructible_v<key_type>):
+    k_(k)
+  {
+    descend(r); next();
+  }
+
+  overlapiterator(overlapiterator const&) = default;
+  overlapiterator(overlapiterator&&) = default;
+
+  overlapiterator(inverse_const_t const& o)
+    noexcept(std::is_nothrow_copy_constructible_v<key_type>)
+    requires(std::is_const_v<T>):
+    p_(o.p_),
+    n_(o.n_),
+    i_(o.i_),
+    k_(o.k_)
+  {
+  }
+
+  //
+  overlapiterator& operator=(overlapiterator const&) = default;
+  overlapiterator& operator=(overlapiterator&&) = default;
+
+  bool operator==(overlapiterator const& o) const noexcept
+  {
+    return (n_ == o.n_) && (i_ == o.i_);
+  }
+
+  bool operator==(std::default_sentinel_t) const noexcept { return !n_; }
+
+  // increment
+  auto& operator++() noexcept
+  {
+    if (++i_ == n_->v_.end()) next();
+
+    return *this;
+  }
+
+  auto operator++(int) noexcept { auto const r(*this); ++*this; return r; }
+
+  // member access
+  auto& operator->() const noexcept { return i_; }
+  auto& operator*() const noexcept { return *i_; }
+
+  //
+  auto& i() const noexcept { return i_; }
+  auto n() const noexcept { return n_; }
+
+  //
+  explicit operator bool() const noexcept { return n_; }
+};
+
+}
+
+#endif // SG_OVERLAPITERATOR_HPP
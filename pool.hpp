@@ -0,0 +1,210 @@
+#ifndef SG_POOL_HPP
+# define SG_POOL_HPP
+# pragma once
+
+#include <cstddef>
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace sg
+{
+
+template <typename> class pool_allocator;
+
+namespace detail
+{
+
+class slab_pool
+{ // free lists of blocks, one per block size, carved out of slabs that live
+  // as long as the pool, not thread-safe
+  template <typename> friend class sg::pool_allocator;
+
+  static constexpr std::size_t unit{__STDCPP_DEFAULT_NEW_ALIGNMENT__};
+  static constexpr std::size_t classes{16}; // blocks of 1 to 16 units
+
+  struct link { link* n_; };
+
+  struct free_list
+  {
+    link* f_{}; // free blocks
+    std::byte* b_{}, *e_{}; // unused tail of the newest slab
+    std::size_t c_{}; // blocks in the newest slab
+  };
+
+  std::size_t r_{1}; // handles sharing the pool
+  void* s_{}; // slabs, linked through their first units
+  free_list l_[classes];
+
+  template <typename T>
+  static constexpr bool fits{
+    (alignof(T) <= unit) && (sizeof(T) <= classes * unit)};
+
+  template <typename T>
+  static constexpr std::size_t class_of{(sizeof(T) - 1) / unit};
+
+  void grow(std::size_t const k, std::size_t const n)
+  {
+    auto const z((k + 1) * unit);
+    auto& l(l_[k]);
+
+    for (; l.b_ != l.e_; l.b_ += z) deallocate(l.b_, k); // keep the tail
+
+    auto const s(static_cast<std::byte*>(::operator new(unit + n * z)));
+    std::construct_at(reinterpret_cast<void**>(s), s_);
+
+    s_ = s; l.b_ = s + unit; l.e_ = l.b_ + n * z; l.c_ = n;
+  }
+
+  slab_pool() = default;
+
+  slab_pool(slab_pool const&) = delete;
+
+  ~slab_pool() { release(); }
+
+  //
+  slab_pool& operator=(slab_pool const&) = delete;
+
+  //
+  void* allocate(std::size_t const k)
+  {
+    auto& l(l_[k]);
+
+    if (l.f_)
+    {
+      return std::exchange(l.f_, l.f_->n_);
+    }
+    else if (l.b_ == l.e_)
+    {
+      grow(k, l.c_ ? 2 * l.c_ : 16);
+    }
+
+    return std::exchange(l.b_, l.b_ + (k + 1) * unit);
+  }
+
+  void deallocate(void* const p, std::size_t const k) noexcept
+  {
+    auto& l(l_[k]); l.f_ = std::construct_at(static_cast<link*>(p), l.f_);
+  }
+
+  void release() noexcept
+  { // every block goes at once
+    for (auto s(std::exchange(s_, nullptr)); s;)
+    {
+      ::operator delete(std::exchange(s, *static_cast<void**>(s)));
+    }
+
+    for (auto& l: l_) l = {};
+  }
+
+  void reserve(std::size_t const k, std::size_t const n)
+  { // make room for n more blocks in a single slab
+    auto const& l(l_[k]);
+
+    if (std::size_t(l.e_ - l.b_) / ((k + 1) * unit) < n)
+    {
+      grow(k, std::max(n, 2 * l.c_));
+    }
+  }
+};
+
+}
+
+template <typename T>
+class pool_allocator
+{ // copies and rebinds share one pool, the last of them frees it, single
+  // objects come from the pool, arrays and over-aligned or large objects
+  // from the heap
+  template <typename> friend class pool_allocator;
+
+  using pool = detail::slab_pool;
+
+  pool* p_;
+
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+  using is_always_equal = std::false_type;
+
+  pool_allocator(): p_(new pool) { }
+
+  // a moved-from allocator has to stay equal to its old value, so moves copy
+  pool_allocator(pool_allocator const& o) noexcept: p_(o.p_) { ++p_->r_; }
+
+  template <typename U>
+  pool_allocator(pool_allocator<U> const& o) noexcept: p_(o.p_) { ++p_->r_; }
+
+  ~pool_allocator() { if (!--p_->r_) delete p_; }
+
+  //
+  pool_allocator& operator=(pool_allocator const& o) noexcept
+  {
+    ++o.p_->r_; if (!--p_->r_) delete p_; p_ = o.p_;
+
+    return *this;
+  }
+
+  template <typename U>
+  bool operator==(pool_allocator<U> const& o) const noexcept
+  {
+    return p_ == o.p_;
+  }
+
+  //
+  auto select_on_container_copy_construction() const
+  {
+    return pool_allocator();
+  }
+
+  //
+  T* allocate(std::size_t const n)
+  {
+    if constexpr(pool::fits<T>)
+    {
+      if (1 == n)
+      {
+        return static_cast<T*>(p_->allocate(pool::class_of<T>));
+      }
+    }
+
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T* const p, std::size_t const n) noexcept
+  {
+    if constexpr(pool::fits<T>)
+    {
+      if (1 == n)
+      {
+        p_->deallocate(p, pool::class_of<T>); return;
+      }
+    }
+
+    std::allocator<T>().deallocate(p, n);
+  }
+
+  //
+  void release() noexcept
+  { // free every slab, blocks other handles still hold included
+    p_->release();
+  }
+
+  void reserve(std::size_t const n)
+  {
+    if constexpr(pool::fits<T>) p_->reserve(pool::class_of<T>, n);
+  }
+
+  bool unique() const noexcept { return 1 == p_->r_; }
+};
+
+}
+
+#endif // SG_POOL_HPP
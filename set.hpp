@@ -4,12 +4,15 @@
 
 #include "utils.hpp"
 
+#include "mapcursor.hpp"
 #include "mapiterator.hpp"
 
 namespace sg
 {
 
-template <typename Key, class Compare = std::compare_three_way>
+template <typename Key, class Compare = std::compare_three_way,
+  class Alpha = std::ratio<2, 3>, node_policy Policy = plain_nodes,
+  class Allocator = std::allocator<Key>>
 class set
 {
 public:
@@ -17,6 +20,7 @@ public:
 
   using key_type = Key;
   using value_type = Key;
+  using allocator_type = Allocator;
 
   using difference_type = detail::difference_type;
   using size_type = detail::size_type;
@@ -28,13 +32,20 @@ public:
   using const_iterator = mapiterator<node const>;
   using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
+  using cursor = mapcursor<node>;
+  using const_cursor = mapcursor<node const>;
+
   struct node
   {
     using value_type = set::value_type;
 
+    using alpha = Alpha;
+
     static constinit inline Compare const cmp;
 
-    node* l_{}, *r_{};
+    detail::link_t<node, Policy> l_{}, r_{};
+    [[no_unique_address]] detail::parent_t<node, Policy> p_{};
+    [[no_unique_address]] detail::count_t<Policy> c_{1};
     Key const kv_;
 
     explicit node(auto&& ...a)
@@ -43,74 +54,99 @@ public:
     {
     }
 
-    ~node() noexcept(std::is_nothrow_destructible_v<decltype(kv_)>)
-    {
-      delete l_; delete r_;
-    }
-
     //
     auto& key() const noexcept { return kv_; }
 
     //
-    static auto emplace(auto& r, auto&& k)
+    static auto emplace(auto& al, auto& r, size_type const sz, auto&& k)
+      noexcept(noexcept(new node(std::forward<decltype(k)>(k))))
+      requires(detail::Comparable<Compare, decltype(k), key_type>)
+    {
+      return detail::emplace(r, sz, k, [&]()
+          noexcept(noexcept(new node(std::forward<decltype(k)>(k))))
+          {
+            return detail::create_node(al, std::forward<decltype(k)>(k));
+          }
+        );
+    }
+
+    static auto emplace(auto& al, auto& r, size_type const sz, auto&& ...a)
+      noexcept(noexcept(node::emplace(al, r, sz,
+        key_type(std::forward<decltype(a)>(a)...))))
+      requires(std::is_constructible_v<key_type, decltype(a)...>)
+    {
+      return node::emplace(al, r, sz,
+        key_type(std::forward<decltype(a)>(a)...));
+    }
+
+    static auto emplace_hint(auto& al, auto& r, size_type const sz,
+      node* const h, auto&& k)
       noexcept(noexcept(new node(std::forward<decltype(k)>(k))))
       requires(detail::Comparable<Compare, decltype(k), key_type>)
     {
-      return detail::emplace(r, k, [&]()
+      return detail::emplace_hint(r, sz, h, k, [&]()
           noexcept(noexcept(new node(std::forward<decltype(k)>(k))))
           {
-            return new node(std::forward<decltype(k)>(k));
+            return detail::create_node(al, std::forward<decltype(k)>(k));
           }
         );
     }
 
-    static auto emplace(auto& r, auto&& ...a)
-      noexcept(noexcept(node::emplace(r,
+    static auto emplace_hint(auto& al, auto& r, size_type const sz,
+      node* const h, auto&& ...a)
+      noexcept(noexcept(node::emplace_hint(al, r, sz, h,
         key_type(std::forward<decltype(a)>(a)...))))
       requires(std::is_constructible_v<key_type, decltype(a)...>)
     {
-      return node::emplace(r, key_type(std::forward<decltype(a)>(a)...));
+      return node::emplace_hint(al, r, sz, h,
+        key_type(std::forward<decltype(a)>(a)...));
     }
   };
 
 private:
   using this_class = set;
+  using node_allocator = detail::node_allocator_t<node, Allocator, Policy>;
+
+  [[no_unique_address]] node_allocator a_;
   node* root_{};
+  size_type sz_{}, mx_{}; // mx_: most nodes since the last full rebuild
 
 public:
   set() = default;
 
-  set(set const& o) 
-    noexcept(noexcept(set(o.begin(), o.end())))
+  explicit set(Allocator const& a) noexcept: a_(a) { }
+
+  set(set const& o)
     requires(std::is_copy_constructible_v<value_type>):
-    set(o.begin(), o.end())
+    a_(std::allocator_traits<node_allocator>::
+      select_on_container_copy_construction(o.a_))
   {
+    insert_sorted(o.begin(), o.end());
   }
 
-  set(set&& o)
-    noexcept(noexcept(*this = std::move(o)))
+  set(set&& o) noexcept: a_(std::move(o.a_))
   {
-    *this = std::move(o);
+    detail::assign(root_, sz_, mx_, o.root_, o.sz_, o.mx_)(
+      o.root_, o.sz_, o.mx_, nullptr, 0u, 0u);
   }
 
-  set(std::input_iterator auto const i, decltype(i) j)
-    noexcept(noexcept(insert(i, j)))
+  set(std::input_iterator auto const i, decltype(i) j,
+    Allocator const& a = Allocator()):
+    a_(a)
   {
-    insert(i, j);
+    insert_sorted(i, j);
   }
 
-  set(std::initializer_list<value_type> l)
-    noexcept(noexcept(set(l.begin(), l.end()))):
-    set(l.begin(), l.end())
+  set(std::initializer_list<value_type> l, Allocator const& a = Allocator())
+    noexcept(noexcept(set(l.begin(), l.end(), a))):
+    set(l.begin(), l.end(), a)
   {
   }
 
-  ~set() noexcept(noexcept(delete root_)) { delete root_; }
+  ~set() noexcept(noexcept(delete root_)) { detail::destroy(a_, root_); }
 
 # include "common.hpp"
-
-  //
-  auto size() const noexcept { return detail::size(root_); }
+# include "setops.hpp"
 
   //
   template <int = 0>
@@ -124,13 +160,28 @@ public:
 
   //
   auto emplace(auto&& ...a)
-    noexcept(noexcept(node::emplace(root_, std::forward<decltype(a)>(a)...)))
+    noexcept(noexcept(
+      node::emplace(a_, root_, sz_, std::forward<decltype(a)>(a)...)))
   {
-    auto const [n, s](node::emplace(root_, std::forward<decltype(a)>(a)...));
+    auto const [n, s](
+      node::emplace(a_, root_, sz_, std::forward<decltype(a)>(a)...));
+    sz_ += s;
 
     return std::pair(iterator(&root_, n), s);
   }
 
+  iterator emplace_hint(const_iterator const h, auto&& ...a)
+    noexcept(noexcept(
+      node::emplace_hint(a_, root_, sz_, h.n(),
+        std::forward<decltype(a)>(a)...)))
+  {
+    auto const [n, s](node::emplace_hint(a_, root_, sz_, h.n(),
+      std::forward<decltype(a)>(a)...));
+    sz_ += s;
+
+    return {&root_, n};
+  }
+
   //
   template <int = 0>
   auto equal_range(auto const& k) noexcept
@@ -160,11 +211,15 @@ public:
   //
   template <int = 0>
   size_type erase(auto const& k)
-    noexcept(noexcept(detail::erase(root_, k)))
+    noexcept(noexcept(detail::erase(a_, root_, k)))
     requires(detail::Comparable<Compare, decltype(k), key_type> &&
       !std::convertible_to<decltype(k), const_iterator>)
   {
-    return bool(detail::erase(root_, k));
+    auto const s(detail::erase(a_, root_, k));
+    sz_ -= s;
+    detail::compact(root_, sz_, mx_, s);
+
+    return size_type(s);
   }
 
   auto erase(key_type const k) noexcept(noexcept(erase<0>(k)))
@@ -173,18 +228,27 @@ public:
   }
 
   iterator erase(const_iterator const i)
-    noexcept(noexcept(detail::erase(root_, *i)))
+    noexcept(noexcept(delete root_))
   {
-    return {&root_, detail::erase(root_, *i)};
+    auto const [q, p](detail::node_slot(root_, i.n()));
+    --sz_;
+
+    iterator const r(&root_, std::get<0>(detail::erase(a_, root_, q, p)));
+    detail::compact(root_, sz_, mx_, 1);
+
+    return r;
   }
 
   //
   template <int = 0>
   auto insert(auto&& k)
-    noexcept(noexcept(node::emplace(root_, std::forward<decltype(k)>(k))))
+    noexcept(noexcept(
+      node::emplace(a_, root_, sz_, std::forward<decltype(k)>(k))))
     requires(detail::Comparable<Compare, decltype(k), key_type>)
   {
-    auto const [n, s](node::emplace(root_, std::forward<decltype(k)>(k)));
+    auto const [n, s](
+      node::emplace(a_, root_, sz_, std::forward<decltype(k)>(k)));
+    sz_ += s;
 
     return std::pair(iterator(&root_, n), s);
   }
@@ -195,6 +259,12 @@ public:
     return insert<0>(std::move(k));
   }
 
+  iterator insert(const_iterator const h, value_type k)
+    noexcept(noexcept(emplace_hint(h, std::move(k))))
+  {
+    return emplace_hint(h, std::move(k));
+  }
+
   void insert(std::input_iterator auto const i, decltype(i) j)
     noexcept(noexcept(emplace(*i)))
   {
@@ -210,43 +280,54 @@ public:
 };
 
 //////////////////////////////////////////////////////////////////////////////
-template <int = 0, typename K, class C>
-inline auto erase(set<K, C>& c, auto const& k)
+template <int = 0, typename K, class C, class A, node_policy P,
+  class M>
+inline auto erase(set<K, C, A, P, M>& c, auto const& k)
   noexcept(noexcept(c.erase(K(k))))
   requires(!detail::Comparable<C, decltype(k), K>)
 {
   return c.erase(K(k));
 }
 
-template <int = 0, typename K, class C>
-inline auto erase(set<K, C>& c, auto const& k)
+template <int = 0, typename K, class C, class A, node_policy P,
+  class M>
+inline auto erase(set<K, C, A, P, M>& c, auto const& k)
   noexcept(noexcept(c.erase(k)))
   requires(detail::Comparable<C, decltype(k), K>)
 {
   return c.erase(k);
 }
 
-template <typename K, class C>
-inline auto erase(set<K, C>& c, K const k)
+template <typename K, class C, class A, node_policy P,
+  class M>
+inline auto erase(set<K, C, A, P, M>& c, K const k)
   noexcept(noexcept(erase<0>(c, k)))
 {
   return erase<0>(c, k);
 }
 
-template <typename K, class C>
-inline auto erase_if(set<K, C>& c, auto pred)
-  noexcept(noexcept(pred(std::declval<K const&>()), c.erase(c.begin())))
+template <typename K, class C, class A, node_policy P,
+  class M>
+inline auto erase_if(set<K, C, A, P, M>& c, auto pred)
+  noexcept(noexcept(c.erase_if(pred)))
 {
-  typename std::remove_reference_t<decltype(c)>::size_type r{};
-
-  for (auto i(c.begin()); i; pred(*i) ? ++r, i = c.erase(i) : ++i);
-
-  return r;
+  return c.erase_if(pred);
 }
 
 //////////////////////////////////////////////////////////////////////////////
-template <typename K, class C>
-inline void swap(set<K, C>& l, decltype(l) r) noexcept { l.swap(r); }
+template <typename K, class C, class A, node_policy P,
+  class M>
+inline void swap(set<K, C, A, P, M>& l, decltype(l) r) noexcept { l.swap(r); }
+
+namespace pmr
+{
+
+template <typename Key, class Compare = std::compare_three_way,
+  class Alpha = std::ratio<2, 3>, node_policy Policy = plain_nodes>
+using set = sg::set<Key, Compare, Alpha, Policy,
+  std::pmr::polymorphic_allocator<Key>>;
+
+}
 
 }
 
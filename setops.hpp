@@ -0,0 +1,132 @@
+// set algebra, in place, over containers with unique keys
+auto& set_union(this_class const& o)
+{
+  if (this == &o) return *this;
+
+  if (detail::sparse(o.sz_, sz_))
+  {
+    detail::sparse_combine<true, true, true>(a_, root_, mx_, sz_,
+      o.begin_cursor(), o.end_cursor());
+  }
+  else
+  {
+    detail::combine<true, true, true>(a_, root_, mx_, sz_,
+      o.begin_cursor(), o.end_cursor());
+  }
+
+  return *this;
+}
+
+auto& set_intersection(this_class const& o)
+{
+  if (this == &o) return *this;
+
+  if (detail::sparse(o.sz_, sz_))
+  { // every node not in o still goes, but without comparisons
+    detail::sparse_combine<false, true, false>(a_, root_, mx_, sz_,
+      o.begin_cursor(), o.end_cursor());
+  }
+  else
+  {
+    detail::combine<false, true, false>(a_, root_, mx_, sz_,
+      o.begin_cursor(), o.end_cursor());
+  }
+
+  return *this;
+}
+
+auto& set_difference(this_class const& o)
+{
+  if (this == &o)
+  {
+    clear();
+  }
+  else if (detail::sparse(o.sz_, sz_))
+  {
+    detail::sparse_combine<true, false, false>(a_, root_, mx_, sz_,
+      o.begin_cursor(), o.end_cursor());
+  }
+  else
+  {
+    detail::combine<true, false, false>(a_, root_, mx_, sz_,
+      o.begin_cursor(), o.end_cursor());
+  }
+
+  return *this;
+}
+
+auto& set_symmetric_difference(this_class const& o)
+{
+  if (this == &o)
+  {
+    clear();
+  }
+  else if (detail::sparse(o.sz_, sz_))
+  {
+    detail::sparse_combine<true, false, true>(a_, root_, mx_, sz_,
+      o.begin_cursor(), o.end_cursor());
+  }
+  else
+  {
+    detail::combine<true, false, true>(a_, root_, mx_, sz_,
+      o.begin_cursor(), o.end_cursor());
+  }
+
+  return *this;
+}
+
+bool includes(this_class const& o) const noexcept
+{
+  if (o.sz_ > sz_) return false;
+
+  if (detail::sparse(o.sz_, sz_))
+  {
+    return std::all_of(
+      o.begin_cursor(),
+      o.end_cursor(),
+      [&](auto const& v) noexcept
+      {
+        return detail::find(root_, detail::key_of<node>(v));
+      }
+    );
+  }
+
+  auto i(begin_cursor());
+
+  for (auto j(o.begin_cursor()); j; ++j)
+  {
+    auto const& k(detail::key_of<node>(*j));
+
+    for (; i && (node::cmp(i.n()->key(), k) < 0); ++i);
+
+    if (!i || (node::cmp(i.n()->key(), k) != 0)) return false;
+  }
+
+  return true;
+}
+
+//
+friend auto set_union(this_class a, this_class const& b)
+{
+  return std::move(a.set_union(b));
+}
+
+friend auto set_intersection(this_class a, this_class const& b)
+{
+  return std::move(a.set_intersection(b));
+}
+
+friend auto set_difference(this_class a, this_class const& b)
+{
+  return std::move(a.set_difference(b));
+}
+
+friend auto set_symmetric_difference(this_class a, this_class const& b)
+{
+  return std::move(a.set_symmetric_difference(b));
+}
+
+friend bool includes(this_class const& a, this_class const& b) noexcept
+{
+  return a.includes(b);
+}
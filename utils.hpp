@@ -2,23 +2,46 @@
 #define SG_UTILS_HPP
 # pragma once
 
-#if defined(_WIN32)
-# include <malloc.h>
-# define SG_ALLOCA(x) _alloca(x)
-#else
-# include <stdlib.h>
-# define SG_ALLOCA(x) alloca(x)
-#endif // SG_ALLOCA
-
 #include <cassert>
+#include <cmath>
 #include <cstdint>
 
 #include <algorithm>
+#include <bit>
 #include <compare>
-
-#include <numeric> // std::midpoint()
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <numeric>
+
+#include <ranges>
+#include <ratio>
+#include <span>
 #include <tuple>
 #include <utility>
+#include <vector>
+
+#include "buckets.hpp"
+#include "indexpool.hpp"
+
+namespace sg
+{
+
+enum node_policy : unsigned
+{
+  plain_nodes,
+  parent_links = 1, // O(1) amortized iteration, comparison-free unlinking
+  subtree_counts = 2, // O(log n) nth(), rank() and iterator arithmetic
+  index_links = 4, // 32-bit links into a node pool owned by the container
+  counted_duplicates = 8 // multiset: a key and its count instead of copies
+};
+
+constexpr auto operator|(node_policy const a, node_policy const b) noexcept
+{
+  return node_policy(unsigned(a) | unsigned(b));
+}
+
+}
 
 namespace sg::detail
 {
@@ -26,6 +49,67 @@ namespace sg::detail
 using difference_type = std::ptrdiff_t;
 using size_type = std::size_t;
 
+struct empty {};
+
+template <class N, node_policy P>
+using link_t = std::conditional_t<bool(P & index_links), link<N>, N*>;
+
+template <class N, node_policy P>
+using parent_t =
+  std::conditional_t<bool(P & parent_links), link_t<N, P>, empty>;
+
+template <class N, class A, node_policy P>
+using node_allocator_t = std::conditional_t<bool(P & index_links),
+  index_pool<N, A>,
+  typename std::allocator_traits<A>::template rebind_alloc<N>>;
+
+// the duplicates of a key held by a node of a multi-container, allocating
+// through A
+template <class T, class A, node_policy P>
+using bucket_t = std::conditional_t<bool(P & counted_duplicates),
+  counted_bucket<T>,
+  inline_bucket<T,
+    typename std::allocator_traits<A>::template rebind_alloc<T>>>;
+
+// erasing from the bucket of N, if any, does not throw
+template <class N>
+concept NothrowErasable = !requires(N& n){ n.v_; } ||
+  requires(N& n){ { n.v_.erase(n.v_.cbegin(), n.v_.cend()) } noexcept; };
+
+template <class L>
+struct node_of { using type = std::remove_pointer_t<L>; };
+
+template <class N>
+struct node_of<link<N>> { using type = N; };
+
+// the node type a pointer or link refers to
+template <class L>
+using node_of_t = typename node_of<std::remove_cvref_t<L>>::type;
+
+struct uncounted { constexpr uncounted(size_type) noexcept { } };
+struct unweighted { constexpr unweighted(size_type) noexcept { } };
+
+// nodes in, and elements held by, a subtree
+template <node_policy P>
+using count_t =
+  std::conditional_t<bool(P & subtree_counts), size_type, uncounted>;
+
+template <node_policy P>
+using weight_t =
+  std::conditional_t<bool(P & subtree_counts), size_type, unweighted>;
+
+template <typename N>
+concept Parented =
+  !std::is_same_v<decltype(std::remove_pointer_t<N>::p_), empty>;
+
+template <typename N>
+concept Counted =
+  std::is_same_v<decltype(std::remove_pointer_t<N>::c_), size_type>;
+
+template <typename N>
+concept Weighted =
+  std::is_same_v<decltype(std::remove_pointer_t<N>::w_), size_type>;
+
 template <class C, class U, class V>
 concept Comparable =
   !std::is_void_v<
@@ -42,8 +126,82 @@ inline auto assign(auto& ...a) noexcept
 }
 
 //
-inline auto left_node(auto const n) noexcept { return n->l_; }
-inline auto right_node(auto const n) noexcept { return n->r_; }
+inline auto left_node(auto const n) noexcept
+{
+  return static_cast<std::remove_const_t<node_of_t<decltype(n)>>*>(n->l_);
+}
+
+inline auto right_node(auto const n) noexcept
+{
+  return static_cast<std::remove_const_t<node_of_t<decltype(n)>>*>(n->r_);
+}
+
+inline auto parent_link(auto const n) noexcept
+{ // the parent of n, if nodes have parent links
+  if constexpr(Parented<decltype(n)>) return decltype(n)(n->p_);
+  else return empty{};
+}
+
+template <class N>
+class slot
+{ // where a node hangs from: the root pointer or a link of its parent,
+  // index links are tagged by the low bit
+  static constexpr bool indexed{!std::is_pointer_v<decltype(N::l_)>};
+
+  std::conditional_t<indexed, std::uintptr_t, N**> q_;
+
+public:
+  slot(N** const r) noexcept: q_(reinterpret_cast<decltype(q_)>(r)) { }
+
+  slot(link<N>* const l) noexcept requires(indexed):
+    q_(reinterpret_cast<std::uintptr_t>(l) | 1)
+  {
+  }
+
+  //
+  bool operator==(slot const&) const = default;
+
+  N* get() const noexcept
+  {
+    if constexpr(indexed)
+    {
+      return q_ & 1 ? reinterpret_cast<link<N>*>(q_ ^ 1)->get() :
+        *reinterpret_cast<N**>(q_);
+    }
+    else
+    {
+      return *q_;
+    }
+  }
+
+  N* set(N* const n) const noexcept
+  {
+    if constexpr(indexed)
+    {
+      if (q_ & 1) *reinterpret_cast<link<N>*>(q_ ^ 1) = n;
+      else *reinterpret_cast<N**>(q_) = n;
+    }
+    else
+    {
+      *q_ = n;
+    }
+
+    return n;
+  }
+};
+
+inline auto slot_of(auto& l) noexcept
+{ // the slot of pointer or link l
+  return slot<node_of_t<decltype(l)>>(&l);
+}
+
+inline void set_parent(auto const c, auto const p) noexcept
+{
+  if constexpr(Parented<decltype(c)>)
+  {
+    if (c) c->p_ = p;
+  }
+}
 
 inline auto first_node(auto n) noexcept
 { // first node of node subtree, can be node itself
@@ -78,21 +236,28 @@ inline auto parent_node(auto r0, decltype(r0) n) noexcept
 {
   using node = std::remove_const_t<std::remove_pointer_t<decltype(n)>>;
 
-  auto const& key(n->key());
-
-  for (n = {};;)
+  if constexpr(Parented<decltype(n)>)
   {
-    if (auto const c(node::cmp(key, r0->key())); c < 0)
-    {
-      assign(n, r0)(r0, left_node(r0));
-    }
-    else if (c > 0)
-    {
-      assign(n, r0)(r0, right_node(r0));
-    }
-    else [[unlikely]]
+    return decltype(n)(n->p_);
+  }
+  else
+  {
+    auto const& key(n->key());
+
+    for (n = {};;)
     {
-      return n;
+      if (auto const c(node::cmp(key, r0->key())); c < 0)
+      {
+        assign(n, r0)(r0, left_node(r0));
+      }
+      else if (c > 0)
+      {
+        assign(n, r0)(r0, right_node(r0));
+      }
+      else [[unlikely]]
+      {
+        return n;
+      }
     }
   }
 }
@@ -105,6 +270,12 @@ inline auto next_node(auto r0, decltype(r0) n) noexcept
   {
     return first_node(rn);
   }
+  else if constexpr(Parented<decltype(n)>)
+  { // climb while we are a right child
+    for (decltype(n) p; (p = n->p_) && (right_node(p) == n); n = p);
+
+    return decltype(n)(n->p_);
+  }
   else
   {
     auto const& key(n->key());
@@ -135,6 +306,12 @@ inline auto prev_node(auto r0, decltype(r0) n) noexcept
   {
     return last_node(ln);
   }
+  else if constexpr(Parented<decltype(n)>)
+  { // climb while we are a left child
+    for (decltype(n) p; (p = n->p_) && (left_node(p) == n); n = p);
+
+    return decltype(n)(n->p_);
+  }
   else
   {
     auto const& key(n->key());
@@ -168,10 +345,160 @@ inline size_type height(auto const n) noexcept
 
 inline size_type size(auto const n) noexcept
 {
-  return n ? size_type(1) + size(left_node(n)) + size(right_node(n)) :
-    size_type{};
+  if constexpr(Counted<decltype(n)>)
+  {
+    return n ? n->c_ : size_type{};
+  }
+  else
+  {
+    return n ? size_type(1) + size(left_node(n)) + size(right_node(n)) :
+      size_type{};
+  }
+}
+
+inline size_type bucket_size(auto const n) noexcept
+{ // elements held by node n
+  if constexpr(requires{ n->v_.size(); }) return n->v_.size(); else return 1;
+}
+
+inline size_type weight(auto const n) noexcept
+{ // elements held by the subtree of n, nodes are elements without buckets
+  if constexpr(Weighted<decltype(n)>)
+  {
+    return n ? n->w_ : size_type{};
+  }
+  else
+  {
+    return size(n);
+  }
+}
+
+template <class A>
+inline size_type max_depth(size_type const sz) noexcept
+{ // floor(log_{1/alpha}(sz)), the height bound of an alpha-balanced tree
+  static_assert(std::ratio_less_v<std::ratio<1, 2>, A> &&
+    std::ratio_less_v<A, std::ratio<1>>, "alpha must lie in (1/2, 1)");
+
+  return std::log2(sz) / std::log2(double(A::den) / A::num);
+}
+
+template <class A>
+constexpr bool unbalanced(size_type const sc, size_type const s) noexcept
+{ // is a child subtree of size sc heavier than alpha * s?
+  return A::den * sc > A::num * s;
+}
+
+template <class A>
+consteval size_type max_path() noexcept
+{ // max_depth<A>(~size_type{}) + 1 nodes on a root path, plus 1 for slack
+  constexpr auto q((long double)(A::den) / A::num);
+
+  size_type h(1);
+
+  for (long double n(1); n <= ~size_type{}; n *= q, ++h);
+
+  return h;
 }
 
+constexpr bool sparse(size_type const m, size_type const n) noexcept
+{ // do m searches in a tree of n nodes beat a linear walk over it?
+  return m * std::bit_width(n) < n;
+}
+
+template <class N>
+class path
+{ // root-to-node ancestor stack, walks in-order without comparisons
+  using node_t = std::remove_const_t<N>;
+
+  N* a_[max_path<typename node_t::alpha>()];
+  unsigned d_{};
+
+public:
+  path() = default;
+
+  path(path const& o) noexcept: d_(o.d_) { std::copy_n(o.a_, d_, a_); }
+
+  path& operator=(path const& o) noexcept
+  {
+    std::copy_n(o.a_, d_ = o.d_, a_); return *this;
+  }
+
+  //
+  N* top() const noexcept { return d_ ? a_[d_ - 1] : nullptr; }
+
+  void push(N* const n) noexcept
+  {
+    assert(d_ < std::size(a_)); a_[d_++] = n;
+  }
+
+  void pop() noexcept { assert(d_); --d_; }
+
+  auto& first(N* n) noexcept
+  {
+    for (; n; n = left_node(n)) push(n);
+
+    return *this;
+  }
+
+  auto& last(N* n) noexcept
+  {
+    for (; n; n = right_node(n)) push(n);
+
+    return *this;
+  }
+
+  auto& lower_bound(N* n, auto const& k) noexcept
+  { // truncate the search path at the deepest node not less than k
+    decltype(d_) d{};
+
+    while (n)
+    {
+      push(n);
+
+      if (auto const c(node_t::cmp(k, n->key())); c < 0 || c == 0)
+      {
+        d = d_; n = left_node(n);
+      }
+      else
+      {
+        n = right_node(n);
+      }
+    }
+
+    d_ = d;
+
+    return *this;
+  }
+
+  void next() noexcept
+  {
+    if (auto const n(top()); right_node(n))
+    {
+      first(right_node(n));
+    }
+    else
+    { // pop while we ascend from a right child
+      for (N* c; c = a_[--d_], d_ && (right_node(a_[d_ - 1]) == c););
+    }
+  }
+
+  void prev(N* const r) noexcept
+  {
+    if (auto const n(top()); !n)
+    {
+      last(r);
+    }
+    else if (left_node(n))
+    {
+      last(left_node(n));
+    }
+    else
+    { // pop while we ascend from a left child
+      for (N* c; c = a_[--d_], d_ && (left_node(a_[d_ - 1]) == c););
+    }
+  }
+};
+
 //
 inline auto equal_range(auto n, auto const& k) noexcept
   requires(Comparable<decltype(n->cmp), decltype(k), decltype(n->key())>)
@@ -228,154 +555,1262 @@ inline auto find(auto n, auto const& k) noexcept
   return n;
 }
 
-inline auto erase(auto& r0, auto const& k)
-  noexcept(noexcept(delete r0))
-  requires(Comparable<decltype(r0->cmp), decltype(k), decltype(r0->key())>)
-{
-  using pointer = std::remove_cvref_t<decltype(r0)>;
-  using node = std::remove_pointer_t<pointer>;
+inline void prefetch(auto const* const p, size_type const i = 0) noexcept
+{ // p + i may lie past the end or be null, prefetching it does not fault
+#if defined(__GNUC__)
+  __builtin_prefetch(reinterpret_cast<void const*>(
+    reinterpret_cast<std::uintptr_t>(p) + i * sizeof(*p)));
+#endif
+}
 
-  for (auto q(&r0); *q;)
+template <bool Lower = false>
+inline void find_many(auto const r0, size_type const m, auto&& key,
+  auto&& f) noexcept(noexcept(f(size_type{}, r0)))
+{ // look up key(0), ..., key(m - 1) in lanes descending in lockstep, each
+  // prefetching its next node, so the cache misses of the lanes overlap,
+  // f(i, n) gets the node holding key(i), or (Lower) the first node not
+  // less than it, the lanes finish out of order
+  using node_t = std::remove_const_t<std::remove_pointer_t<decltype(r0)>>;
+
+  struct
   {
-    auto const n(*q);
+    node_t* n, *g;
+    size_type i;
+  } l[16];
 
-    if (auto const c(node::cmp(k, n->key())); c < 0)
-    {
-      q = &n->l_;
-    }
-    else if (c > 0)
-    {
-      q = &n->r_;
-    }
-    else [[unlikely]]
+  size_type a{}, j{}; // active lanes, next key
+
+  for (; (a != std::size(l)) && (j != m); ++a, ++j) l[a] = {r0, {}, j};
+
+  while (a)
+  {
+    for (size_type i{}; i != a;)
     {
-      auto const nxt(next_node(r0, n));
+      auto& x(l[i]);
 
-      if (auto const l(left_node(n)), r(right_node(n)); l && r)
+      if (x.n)
       {
-        if (size(l) < size(r))
+        if (auto const c(node_t::cmp(key(x.i), x.n->key())); c < 0)
         {
-          auto const [fnn, fnp](first_node2(r, n));
-
-          assign(*q, fnn->l_)(fnn, l);
-
-          if (r != fnn)
-          { // avoid loop
-            assign(fnp->l_, fnn->r_)(right_node(fnn), r);
-          }
+          x.g = x.n; prefetch(x.n = left_node(x.n)); ++i; continue;
         }
-        else
+        else if (c > 0)
         {
-          auto const [lnn, lnp](last_node2(l, n));
-
-          assign(*q, lnn->r_)(lnn, r);
-
-          if (l != lnn)
-          { // avoid loop
-            assign(lnp->r_, lnn->l_)(left_node(lnn), l);
-          }
+          prefetch(x.n = right_node(x.n)); ++i; continue;
         }
-      }
-      else
-      {
-        *q = l ? l : r;
+
+        x.g = x.n;
       }
 
-      assign(n->l_, n->r_)(nullptr, nullptr);
-      delete n;
+      f(x.i, Lower ? x.g : x.n);
 
-      return nxt;
+      if (j != m) x = {r0, {}, j++}, ++i; else x = l[--a];
     }
   }
-
-  return pointer{};
 }
 
-inline auto rebalance(auto const n, size_type const sz) noexcept
-{
-  using node_t = std::remove_pointer_t<std::remove_const_t<decltype(n)>>;
-
-  auto const a{static_cast<node_t**>(SG_ALLOCA(sizeof(n) * sz))};
-
-  struct S
+inline auto select(auto n, size_type k) noexcept
+{ // the node holding the element of rank k, and its offset in the bucket
+  while (n)
   {
-    std::remove_const_t<decltype(a)> b_;
-
-    void operator()(decltype(n) n) noexcept
+    if (auto const wl(weight(left_node(n))); k < wl)
     {
-      if (n)
-      {
-        operator()(detail::left_node(n));
-
-        *b_++ = n;
-
-        operator()(detail::right_node(n));
-      }
+      n = left_node(n);
     }
-
-    static node_t* f(decltype(a) a, decltype(a) b) noexcept
+    else if ((k -= wl) < bucket_size(n))
     {
-      node_t* n;
+      break;
+    }
+    else
+    {
+      k -= bucket_size(n); n = right_node(n);
+    }
+  }
 
-      if (b == a)
-      {
-        n = *a; detail::assign(n->l_, n->r_)(nullptr, nullptr);
-      }
-      else if (b == a + 1)
-      {
-        auto const nb((n = *a)->r_ = *b);
+  return std::pair(n, k);
+}
 
-        detail::assign(nb->l_, nb->r_, n->l_)(nullptr, nullptr, nullptr);
-      }
-      else
-      {
-        auto const m(std::midpoint(a, b));
-        n = *m;
+inline size_type rank(auto n, auto const& k) noexcept
+  requires(Comparable<decltype(n->cmp), decltype(k), decltype(n->key())>)
+{ // the number of elements with keys less than k
+  using node = std::remove_const_t<std::remove_pointer_t<decltype(n)>>;
 
-        detail::assign(n->l_, n->r_)(f(a, m - 1), f(m + 1, b));
-      }
+  size_type r{};
 
-      return n;
+  while (n)
+  {
+    if (node::cmp(k, n->key()) <= 0)
+    {
+      n = left_node(n);
     }
-  };
-
-  S s{a}; s(n);
+    else
+    {
+      r += weight(left_node(n)) + bucket_size(n); n = right_node(n);
+    }
+  }
 
-  return S::f(a, s.b_ - 1);
+  return r;
 }
 
-inline auto emplace(auto& r, auto const& k, auto const& create_node)
-  noexcept(noexcept(create_node()))
-{
-  using node_t = std::remove_pointer_t<std::remove_reference_t<decltype(r)>>;
-
-  struct S
+inline size_type position(auto const r0, auto n) noexcept
+{ // the rank of the first element of n, null n being the end
+  if (!n)
   {
-    decltype(k) k_;
-    decltype(create_node) create_node_;
-
-    node_t* q_;
-    bool s_;
+    return weight(r0);
+  }
+  else if constexpr(Parented<decltype(n)>)
+  {
+    auto r(weight(left_node(n)));
 
-    explicit S(decltype(k) k, decltype(create_node) cn) noexcept:
-      k_(k), create_node_(cn)
+    for (decltype(n) p; (p = n->p_); n = p)
     {
+      if (right_node(p) == n) r += weight(left_node(p)) + bucket_size(p);
     }
 
-    size_type operator()(decltype(r) r) noexcept(noexcept(create_node_()))
-    {
-      if (!r) { assign(q_, s_)(r = create_node_(), true); return 1; }
+    return r;
+  }
+  else
+  {
+    return rank(r0, n->key());
+  }
+}
 
-      //
-      size_type sl, sr;
+inline auto find_slot(auto& r0, auto const& k) noexcept
+  requires(Comparable<decltype(r0->cmp), decltype(k), decltype(r0->key())>)
+{ // the link to the node with key k (null if there is none) and its owner
+  using pointer = std::remove_cvref_t<decltype(r0)>;
+  using node = std::remove_pointer_t<pointer>;
+
+  pointer p{};
+  auto q(slot_of(r0));
+
+  for (pointer n; (n = q.get());)
+  {
+    if (auto const c(node::cmp(k, n->key())); c < 0)
+    {
+      assign(p, q)(n, slot_of(n->l_));
+    }
+    else if (c > 0)
+    {
+      assign(p, q)(n, slot_of(n->r_));
+    }
+    else [[unlikely]]
+    {
+      break;
+    }
+  }
+
+  return std::pair(q, p);
+}
+
+inline auto node_slot(auto& r0, auto const n) noexcept
+{ // the link to n and its owner, comparison-free with parent links
+  auto const p(parent_node(r0, n));
+
+  return std::pair(!p ? slot_of(r0) : left_node(p) == n ? slot_of(p->l_) :
+    slot_of(p->r_), p);
+}
+
+inline bool right_heavy(auto l, decltype(l) r) noexcept
+{ // is r bigger than its sibling l? without counts, the longer of the 2
+  // inner spines, ending in the candidates to replace the parent, decides
+  if constexpr(Counted<decltype(l)>)
+  {
+    return size(l) < size(r);
+  }
+  else
+  {
+    while ((l = right_node(l)) && (r = left_node(r)));
+
+    return !l;
+  }
+}
+
+inline auto unlink(auto const q, auto const p) noexcept
+{ // splice the node in slot q, linked from p, out of the tree, return the
+  // deepest node whose subtree changed
+  auto const n(q.get());
+  std::remove_const_t<decltype(n)> x(p);
+
+  if (auto const l(left_node(n)), r(right_node(n)); l && r)
+  {
+    if (right_heavy(l, r))
+    {
+      auto const [fnn, fnp](first_node2(r, n));
+
+      q.set(fnn);
+      assign(fnn->l_, x)(l, fnn);
+      set_parent(l, fnn);
+
+      if (r != fnn)
+      { // avoid loop
+        assign(fnp->l_, fnn->r_, x)(right_node(fnn), r, fnp);
+        set_parent(left_node(fnp), fnp); set_parent(r, fnn);
+      }
+
+      set_parent(fnn, p);
+    }
+    else
+    {
+      auto const [lnn, lnp](last_node2(l, n));
+
+      q.set(lnn);
+      assign(lnn->r_, x)(r, lnn);
+      set_parent(r, lnn);
+
+      if (l != lnn)
+      { // avoid loop
+        assign(lnp->r_, lnn->l_, x)(left_node(lnn), l, lnp);
+        set_parent(right_node(lnp), lnp); set_parent(l, lnn);
+      }
+
+      set_parent(lnn, p);
+    }
+  }
+  else
+  {
+    set_parent(q.set(l ? l : r), p);
+  }
+
+  return x;
+}
+
+inline void update(auto const n) noexcept
+{ // refresh whatever n caches about its subtree, if anything
+  using node_t = std::remove_pointer_t<std::remove_const_t<decltype(n)>>;
+
+  if constexpr(Counted<node_t*>)
+  {
+    n->c_ = 1 + size(left_node(n)) + size(right_node(n));
+  }
+
+  if constexpr(Weighted<node_t*>)
+  {
+    n->w_ = bucket_size(n) + weight(left_node(n)) + weight(right_node(n));
+  }
+
+  if constexpr(requires{ node_t::update(n); }) node_t::update(n);
+}
+
+inline void refresh(auto& r0, auto n) noexcept
+{ // n, or its bucket, changed, refresh the caches on its root path
+  using node_t = std::remove_pointer_t<std::remove_const_t<decltype(n)>>;
+
+  if constexpr(Counted<node_t*> || requires{ node_t::update(n); })
+  {
+    if constexpr(Parented<node_t*>)
+    {
+      for (; n; n = n->p_) update(n);
+    }
+    else if (n)
+    {
+      path<node_t> p;
+
+      for (auto m(r0); m != n;)
+      {
+        p.push(m);
+        m = node_t::cmp(n->key(), m->key()) < 0 ? left_node(m) : right_node(m);
+      }
+
+      for (update(n); (n = p.top()); p.pop()) update(n);
+    }
+  }
+}
+
+inline auto create_node(auto& a, auto&& ...v)
+{ // allocate and construct a node through allocator a, a node whose bucket
+  // allocates gets a too, after std::allocator_arg
+  using traits = std::allocator_traits<std::remove_cvref_t<decltype(a)>>;
+
+  auto const n(traits::allocate(a, 1));
+
+  try
+  {
+    if constexpr(requires{ typename decltype(n->v_)::allocator_type; })
+    {
+      traits::construct(a, n, std::allocator_arg, std::as_const(a),
+        std::forward<decltype(v)>(v)...);
+    }
+    else
+    {
+      traits::construct(a, n, std::forward<decltype(v)>(v)...);
+    }
+  }
+  catch (...)
+  {
+    traits::deallocate(a, n, 1);
+
+    throw;
+  }
+
+  return n;
+}
+
+template <class N>
+concept Keyed =
+  std::is_same_v<
+    typename N::value_type,
+    std::remove_cvref_t<decltype(std::declval<N const&>().key())>
+  >;
+
+template <class N>
+inline auto& key_of(auto const& v) noexcept
+{ // the key N would file value v under
+  if constexpr(requires{ N::key_of(v); })
+  {
+    return N::key_of(v);
+  }
+  else if constexpr(Keyed<N>)
+  {
+    return v;
+  }
+  else
+  {
+    return std::get<0>(v);
+  }
+}
+
+template <class N>
+inline N* make_node(auto& a, auto&& v)
+{ // a node of type N, holding value v
+  if constexpr(Keyed<N>)
+  {
+    return create_node(a, std::forward<decltype(v)>(v));
+  }
+  else
+  {
+    return create_node(a,
+      std::get<0>(std::forward<decltype(v)>(v)),
+      std::get<1>(std::forward<decltype(v)>(v)));
+  }
+}
+
+inline void destroy_node(auto& a, auto const n)
+  noexcept(noexcept(delete n))
+{
+  using traits = std::allocator_traits<std::remove_cvref_t<decltype(a)>>;
+
+  traits::destroy(a, n);
+  traits::deallocate(a, n, 1);
+}
+
+template <bool Next = true>
+inline auto erase(auto& a, auto& r0, auto const q, auto const p)
+  noexcept(noexcept(delete r0))
+{ // erase the node in slot q, linked from p, return its successor, if asked
+  // for, and what unlink() returns
+  auto const n(q.get());
+  auto const nxt(Next ? next_node(r0, n) : nullptr);
+  auto const x(unlink(q, p));
+
+  destroy_node(a, n);
+  refresh(r0, x);
+
+  return std::pair(nxt, x);
+}
+
+inline bool erase(auto& a, auto& r0, auto const& k)
+  noexcept(noexcept(delete r0))
+  requires(Comparable<decltype(r0->cmp), decltype(k), decltype(r0->key())>)
+{
+  if (auto const [q, p](find_slot(r0, k)); q.get())
+  {
+    erase<false>(a, r0, q, p);
+
+    return true;
+  }
+
+  return false;
+}
+
+inline void destroy(auto& a, auto n) noexcept(noexcept(delete n))
+{ // rotate left children up while deleting, no recursion, no extra space
+  using traits = std::allocator_traits<std::remove_cvref_t<decltype(a)>>;
+
+  bool const pooled([&]() noexcept
+    { // slabs go in one piece, unless another handle may hold blocks in them
+      if constexpr(requires{ a.unique(); })
+      {
+        return a.unique();
+      }
+      else
+      {
+        return requires{ a.release(); };
+      }
+    }()
+  );
+
+  if (!pooled ||
+    !std::is_trivially_destructible_v<std::remove_pointer_t<decltype(n)>>)
+  {
+    while (n)
+    {
+      if (auto const l(left_node(n)); l)
+      {
+        assign(n->l_, l->r_, n)(right_node(l), n, l);
+      }
+      else
+      {
+        auto const r(right_node(n));
+
+        if (pooled) traits::destroy(a, n); else destroy_node(a, n);
+
+        n = r;
+      }
+    }
+  }
+
+  if constexpr(requires{ a.release(); })
+  {
+    if (pooled) a.release();
+  }
+}
+
+inline auto flatten(auto n) noexcept
+{ // tree -> vine: right rotations flatten the subtree into an in-order list
+  // linked through r_, using no extra space
+  for (auto q(slot_of(n)); q.get();)
+  {
+    if (auto const m(q.get()), l(left_node(m)); l)
+    {
+      assign(m->l_, l->r_)(right_node(l), m);
+      q.set(l);
+    }
+    else
+    {
+      q = slot_of(m->r_);
+    }
+  }
+
+  return n;
+}
+
+inline auto build(auto const h, size_type const sz) noexcept
+{ // vine -> tree: consume the list in order, the recursion only goes as
+  // deep as the rebuilt, perfectly balanced, subtree
+  using node_t = std::remove_pointer_t<decltype(h)>;
+
+  struct S
+  {
+    node_t* h_;
+
+    node_t* operator()(size_type const sz) noexcept
+    {
+      if (!sz) return {};
+
+      auto const sl((sz - 1) / 2);
+      auto const l((*this)(sl));
+
+      auto const n(h_);
+      h_ = right_node(n);
+
+      auto const r((*this)(sz - 1 - sl));
+
+      assign(n->l_, n->r_)(l, r);
+      set_parent(l, n); set_parent(r, n);
+      update(n);
+
+      return n;
+    }
+  };
+
+  return S{h}(sz);
+}
+
+inline auto rebalance(auto n, size_type const sz) noexcept
+{
+  auto const p(parent_link(n));
+  auto const r(build(flatten(n), sz));
+  set_parent(r, p);
+
+  return r;
+}
+
+inline void merge(auto& r0, auto i, decltype(i) const j, auto&& key,
+  auto&& create, auto&& bucket)
+{ // merge the sorted range [i, j) into the tree and rebuild it perfectly
+  // balanced, comparing only to merge and to detect duplicates
+  using node_t = std::remove_cvref_t<decltype(*r0)>;
+
+  auto o(flatten(r0));
+
+  node_t* h, *l{};
+  auto t(slot_of(h));
+  size_type sz{};
+
+  auto const append([&](auto const n) noexcept
+    {
+      t.set(l = n); t = slot_of(n->r_); ++sz;
+    }
+  );
+
+  auto const finish([&]() noexcept
+    {
+      for (; o; o = right_node(o)) append(o);
+
+      t.set(nullptr);
+
+      set_parent(r0 = build(h, sz), nullptr);
+    }
+  );
+
+  try
+  {
+    for (; i != j; ++i)
+    {
+      auto&& e(*i);
+      auto const& k(key(e));
+
+      for (; o && (node_t::cmp(k, o->key()) > 0); o = right_node(o))
+      {
+        append(o);
+      }
+
+      if (o && (node_t::cmp(k, o->key()) == 0))
+      {
+        bucket(o, std::forward<decltype(e)>(e));
+      }
+      else if (l && (node_t::cmp(k, l->key()) == 0))
+      {
+        bucket(l, std::forward<decltype(e)>(e));
+      }
+      else
+      {
+        append(create(std::forward<decltype(e)>(e)));
+      }
+    }
+  }
+  catch (...)
+  {
+    finish();
+
+    throw;
+  }
+
+  finish();
+}
+
+template <bool L, bool B, bool R>
+inline void combine(auto& a, auto& r0, size_type& mx, size_type& sz, auto i,
+  decltype(i) const j)
+{ // merge the tree with the sorted, unique range [i, j), keeping keys found
+  // only in the tree (L), in both (B) and only in the range (R), then
+  // rebuild the result perfectly balanced, so mx restarts from its size
+  using node_t = std::remove_cvref_t<decltype(*r0)>;
+
+  auto o(flatten(r0));
+
+  node_t* h;
+  auto t(slot_of(h));
+  sz = {};
+
+  auto const append([&](auto const n) noexcept
+    {
+      t.set(n); t = slot_of(n->r_); ++sz;
+    }
+  );
+
+  auto const drop([&](auto const n) noexcept
+    {
+      auto const r(right_node(n));
+
+      destroy_node(a, n);
+
+      return r;
+    }
+  );
+
+  auto const finish([&]() noexcept
+    {
+      for (; o; o = right_node(o)) append(o);
+
+      t.set(nullptr);
+
+      set_parent(r0 = build(h, sz), nullptr); mx = sz;
+    }
+  );
+
+  try
+  {
+    while (o && (i != j))
+    {
+      if (auto const c(node_t::cmp(o->key(), key_of<node_t>(*i))); c < 0)
+      {
+        if constexpr(L) { append(o); o = right_node(o); } else o = drop(o);
+      }
+      else if (c > 0)
+      {
+        if constexpr(R) append(make_node<node_t>(a, *i));
+
+        ++i;
+      }
+      else
+      {
+        if constexpr(B) { append(o); o = right_node(o); } else o = drop(o);
+
+        ++i;
+      }
+    }
+
+    if constexpr(!L)
+    {
+      while (o) o = drop(o);
+    }
+
+    if constexpr(R)
+    {
+      for (; i != j; ++i) append(make_node<node_t>(a, *i));
+    }
+  }
+  catch (...)
+  {
+    finish();
+
+    throw;
+  }
+
+  finish();
+}
+
+inline void erase_if(auto& a, auto& r0, size_type& nn, size_type& sz,
+  auto&& pred)
+{ // free the elements satisfying pred, and the nodes left empty, in a
+  // single in-order walk, then rebuild the nn nodes of sz elements left
+  // perfectly balanced
+  using node_t = std::remove_pointer_t<std::remove_reference_t<decltype(r0)>>;
+
+  path<node_t> p;
+  p.first(r0);
+
+  node_t* h;
+  auto t(slot_of(h));
+  nn = sz = {};
+
+  auto const next([&]() noexcept
+    { // unstack the next node, its right subtree goes on the stack first,
+      // as appending overwrites r_
+      auto const n(p.top());
+      p.pop(); p.first(right_node(n));
+
+      return n;
+    }
+  );
+
+  auto const append([&](auto const n) noexcept
+    {
+      t.set(n); t = slot_of(n->r_); ++nn; sz += bucket_size(n);
+    }
+  );
+
+  auto const finish([&]() noexcept
+    {
+      while (p.top()) append(next());
+
+      t.set(nullptr);
+
+      set_parent(r0 = build(h, nn), nullptr);
+    }
+  );
+
+  try
+  {
+    for (node_t* n; (n = p.top());)
+    {
+      if constexpr(requires{ n->v_; })
+      {
+        n->v_.remove_if([&](auto& v) { return pred(v); });
+        next();
+
+        if (n->v_.empty()) destroy_node(a, n); else append(n);
+      }
+      else if (pred(n->kv_))
+      {
+        next(); destroy_node(a, n);
+      }
+      else
+      {
+        append(next());
+      }
+    }
+  }
+  catch (...)
+  {
+    finish();
+
+    throw;
+  }
+
+  finish();
+}
+
+inline auto smaller(auto const a, decltype(a) const b) noexcept
+{ // walk both trees in order and in lockstep until one of them runs out,
+  // return whether it was a, and its node and element counts
+  using node_t = std::remove_const_t<std::remove_pointer_t<decltype(a)>>;
+
+  path<node_t> i, j;
+  i.first(a); j.first(b);
+
+  size_type nn{}, sa{}, sb{};
+
+  for (; i.top() && j.top(); i.next(), j.next())
+  {
+    ++nn; sa += bucket_size(i.top()); sb += bucket_size(j.top());
+  }
+
+  auto const s(!i.top());
+
+  return std::tuple(s, nn, s ? sa : sb);
+}
+
+inline auto split(auto& r0, auto const& k) noexcept
+  requires(Comparable<decltype(r0->cmp), decltype(k), decltype(r0->key())>)
+{ // cut the tree along the search path of k, r0 keeps the nodes less than
+  // k, the returned tree gets the rest
+  using node_t = node_of_t<decltype(r0)>;
+
+  struct S
+  {
+    decltype(k) k_;
+
+    void operator()(node_t* const n, slot<node_t> const l, node_t* const lp,
+      slot<node_t> const r, node_t* const rp) noexcept
+    {
+      if (!n)
+      {
+        l.set(nullptr); r.set(nullptr);
+      }
+      else if (node_t::cmp(k_, n->key()) > 0)
+      {
+        set_parent(l.set(n), lp);
+        (*this)(right_node(n), slot_of(n->r_), n, r, rp);
+        update(n);
+      }
+      else
+      {
+        set_parent(r.set(n), rp);
+        (*this)(left_node(n), l, lp, slot_of(n->l_), n);
+        update(n);
+      }
+    }
+  };
+
+  node_t* r;
+  S{k}(r0, slot_of(r0), {}, slot_of(r), {});
+
+  return r;
+}
+
+template <bool R>
+inline void attach(auto& r0, size_type const sz, auto const n) noexcept
+{ // hang n off the rightmost (R) or leftmost node of a tree of sz nodes,
+  // then rebuild at the scapegoat, if n ends up too deep
+  using node_t = std::remove_pointer_t<std::remove_reference_t<decltype(r0)>>;
+
+  struct S
+  {
+    node_t* const n_;
+    size_type const h_;
+
+    size_type operator()(slot<node_t> const q, node_t* const p,
+      size_type const d) noexcept
+    {
+      auto const r(q.get());
+
+      if (!r)
+      {
+        assign(n_->l_, n_->r_)(nullptr, nullptr);
+        set_parent(q.set(n_), p);
+        update(n_);
+
+        return d > h_;
+      }
+
+      size_type s{};
+
+      if (auto const sc((*this)(slot_of(R ? r->r_ : r->l_), r, d + 1)); sc)
+      {
+        auto const so(size(R ? left_node(r) : right_node(r)));
+
+        if (s = 1 + sc + so;
+          unbalanced<typename node_t::alpha>(std::max(sc, so), s))
+        {
+          q.set(rebalance(r, s));
+
+          return {};
+        }
+      }
+
+      update(r);
+
+      return s;
+    }
+  };
+
+  S{n, max_depth<typename node_t::alpha>(sz + 1)}(slot_of(r0), {}, {});
+}
+
+inline auto unlink_last(auto const q) noexcept -> decltype(q.get())
+{ // detach the last node of the subtree in slot q, refreshing the nodes
+  // above it
+  auto const r(q.get());
+
+  if (right_node(r))
+  {
+    auto const m(unlink_last(slot_of(r->r_)));
+    update(r);
+
+    return m;
+  }
+
+  set_parent(q.set(left_node(r)), parent_link(r));
+
+  return r;
+}
+
+inline auto join(auto const a, size_type const sa, decltype(a) b,
+  size_type const sb) noexcept
+{ // concatenate trees of sa and sb nodes, every key in a less than every
+  // key in b
+  using node_t = std::remove_pointer_t<decltype(a)>;
+
+  if (!a || !b)
+  {
+    return a ? a : b;
+  }
+  else if (!unbalanced<typename node_t::alpha>(std::max(sa - 1, sb), sa + sb))
+  { // the last node of a becomes the root
+    auto l(a);
+    auto const m(unlink_last(slot_of(l)));
+
+    assign(m->l_, m->r_)(l, b);
+    set_parent(l, m); set_parent(b, m); set_parent(m, nullptr);
+    update(m);
+
+    return m;
+  }
+  else if (sa < sb ? sparse(sa, sb) : sparse(sb, sa))
+  { // move the nodes of the small tree over one by one
+    auto r(sa < sb ? b : a);
+    auto s(sa < sb ? sb : sa);
+
+    if (sa < sb)
+    { // from the last to the first
+      node_t* v{};
+
+      for (auto n(flatten(a)); n;)
+      {
+        auto const nx(right_node(n));
+        n->r_ = v; v = n; n = nx;
+      }
+
+      for (auto n(v); n;)
+      {
+        auto const nx(right_node(n));
+        attach<false>(r, s++, n);
+        n = nx;
+      }
+    }
+    else
+    {
+      for (auto n(flatten(b)); n;)
+      {
+        auto const nx(right_node(n));
+        attach<true>(r, s++, n);
+        n = nx;
+      }
+    }
+
+    return r;
+  }
+  else
+  {
+    auto const h(flatten(a));
+    last_node(h)->r_ = flatten(b);
+
+    auto const r(build(h, sa + sb));
+    set_parent(r, nullptr);
+
+    return r;
+  }
+}
+
+inline auto erase_range(auto& a, auto& r0, auto const f, decltype(f) e)
+  noexcept(noexcept(delete r0))
+{ // erase the nodes from f up to e (null being the end): cut them out
+  // along both boundary paths, free them and fill the gap with the last
+  // node left of it, return the number of nodes and elements freed
+  using node_t = std::remove_pointer_t<std::remove_reference_t<decltype(r0)>>;
+
+  path<node_t> p;
+  auto q(slot_of(r0));
+
+  for (node_t* n; (n = q.get());)
+  { // the topmost node of the range
+    if (node_t::cmp(n->key(), f->key()) < 0)
+    {
+      p.push(n); q = slot_of(n->r_);
+    }
+    else if (e && (node_t::cmp(n->key(), e->key()) >= 0))
+    {
+      p.push(n); q = slot_of(n->l_);
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  auto const c(q.get());
+  auto lo(left_node(c)), hi(right_node(c));
+
+  assign(c->l_, c->r_)(split(lo, f->key()), hi);
+  hi = e ? split(c->r_, e->key()) : nullptr;
+
+  size_type nn{}, sz{};
+
+  for (auto n(c); n;)
+  {
+    if (auto const l(left_node(n)); l)
+    {
+      assign(n->l_, l->r_, n)(right_node(l), n, l);
+    }
+    else
+    {
+      auto const r(right_node(n));
+
+      ++nn; sz += bucket_size(n);
+      destroy_node(a, n);
+
+      n = r;
+    }
+  }
+
+  if (lo && hi)
+  {
+    auto const m(unlink_last(slot_of(lo)));
+
+    assign(m->l_, m->r_)(lo, hi);
+    set_parent(lo, m); set_parent(hi, m);
+    update(m);
+
+    lo = m;
+  }
+
+  set_parent(q.set(lo ? lo : hi), p.top());
+
+  for (node_t* n; (n = p.top()); p.pop()) update(n);
+
+  return std::pair(nn, sz);
+}
+
+inline void compact(auto& r0, size_type const n, size_type& m,
+  size_type const e) noexcept
+{ // e of n + e nodes just went, rebuild the whole tree once fewer than
+  // alpha times the most nodes it held since its last full rebuild remain
+  using node_t = std::remove_pointer_t<std::remove_reference_t<decltype(r0)>>;
+  using A = typename node_t::alpha;
+
+  if (e)
+  {
+    m = std::max(m, n + e);
+
+    if (A::den * n < A::num * m)
+    {
+      if (r0) set_parent(r0 = build(flatten(r0), n), nullptr);
+
+      m = n;
+    }
+  }
+}
+
+template <bool L, bool B, bool R>
+inline void sparse_combine(auto& a, auto& r0, size_type& mx, size_type& sz,
+  auto i, decltype(i) const j)
+{ // combine() with a range much shorter than the tree: the range is split
+  // at the keys along its search paths, so only O(m log(n/m)) nodes are
+  // visited, subtrees receiving none of it are kept whole (L) or freed
+  // whole, new nodes go in perfectly balanced runs and anything hung too
+  // deep gets the scapegoat rebuild an insert would do
+  using node_t = std::remove_cvref_t<decltype(*r0)>;
+  using A = typename node_t::alpha;
+
+  std::vector<std::remove_reference_t<decltype(*i)>*> e;
+
+  for (; i != j; ++i) e.push_back(std::addressof(*i));
+
+  struct S
+  {
+    decltype(e) const& e_;
+    decltype(a) a_;
+    size_type const h_;
+
+    std::vector<node_t*> f_{}; // the node holding the key of each element
+    size_type c_{}, n_{}; // nodes made and freed
+
+    auto split(node_t* const n, size_type const lo,
+      size_type const hi) const noexcept
+    { // e_[lo, hi) is less than the key of n up to m, is e_[m] equal?
+      auto const m(size_type(std::partition_point(
+          e_.begin() + lo,
+          e_.begin() + hi,
+          [n](auto const v) noexcept
+          {
+            return node_t::cmp(key_of<node_t>(*v), n->key()) < 0;
+          }
+        ) - e_.begin()
+      ));
+
+      return std::pair(m,
+        (m != hi) && (node_t::cmp(key_of<node_t>(*e_[m]), n->key()) == 0));
+    }
+
+    void match(node_t* const n, size_type const lo,
+      size_type const hi) noexcept
+    {
+      if (n && (lo != hi))
+      {
+        auto const [m, eq](split(n, lo, hi));
+
+        match(left_node(n), lo, m);
+        if (eq) f_[m] = n;
+        match(right_node(n), m + eq, hi);
+      }
+    }
+
+    size_type operator()(slot<node_t> const q, node_t* const p,
+      size_type const lo, size_type const hi, size_type const d)
+    { // like emplace(), return the size of the subtree in q, if it holds a
+      // node deeper than h_
+      auto const n(q.get());
+
+      if (lo == hi)
+      {
+        return {};
+      }
+      else if (!n)
+      { // none of e_[lo, hi) is in the tree
+        if constexpr(R)
+        {
+          node_t* h;
+          auto t(slot_of(h));
+          size_type s{};
+
+          try
+          {
+            for (auto k(lo); k != hi; ++k, ++s)
+            {
+              auto const m(make_node<node_t>(a_, *e_[k]));
+              t.set(m); t = slot_of(m->r_);
+            }
+          }
+          catch (...)
+          { // the run made so far still fits here
+            set_parent(q.set(build(h, s)), p); c_ += s;
+
+            throw;
+          }
+
+          set_parent(q.set(build(h, s)), p); c_ += s;
+
+          return d + std::bit_width(s) - 1 > h_ ? s : 0;
+        }
+        else
+        {
+          return {};
+        }
+      }
+
+      auto const [m, eq](split(n, lo, hi));
+
+      size_type sl, sr;
+
+      try
+      {
+        sl = (*this)(slot_of(n->l_), n, lo, m, d + 1);
+        sr = (*this)(slot_of(n->r_), n, m + eq, hi, d + 1);
+      }
+      catch (...)
+      {
+        update(n);
+
+        throw;
+      }
+
+      auto u(n);
+
+      if (!B && eq)
+      { // n goes, the last node of its left subtree takes its place
+        auto const l(left_node(n)), r(right_node(n));
+
+        if (l && r)
+        {
+          u = unlink_last(slot_of(n->l_));
+
+          assign(u->l_, u->r_)(left_node(n), r);
+          set_parent(left_node(u), u); set_parent(r, u);
+
+          sl -= bool(sl);
+        }
+        else
+        {
+          u = l ? l : r;
+        }
+
+        set_parent(q.set(u), p);
+        destroy_node(a_, n); ++n_;
+
+        if (!l || !r) return l ? sl : sr;
+      }
+
+      update(u);
+
+      if (!sl && !sr) return {};
+
+      if (!sl) sl = size(left_node(u));
+      if (!sr) sr = size(right_node(u));
+
+      auto const s(1 + sl + sr);
+
+      if (unbalanced<A>(std::max(sl, sr), s))
+      {
+        q.set(rebalance(u, s));
+
+        return d + std::bit_width(s) - 1 > h_ ? s : 0;
+      }
+
+      return s;
+    }
+  };
+
+  // the depth bound of the largest size the tree can reach
+  S s{e, a, R ? max_depth<A>(sz + e.size()) : size_type{}};
+
+  if constexpr(!L)
+  { // only the matched nodes stay, the rest is freed in order, without
+    // comparisons, and the survivors are rebuilt perfectly balanced
+    static_assert(B && !R);
+
+    s.f_.resize(e.size());
+    s.match(r0, 0, e.size());
+
+    node_t* h;
+    auto t(slot_of(h));
+    size_type k{};
+    sz = {};
+
+    for (auto n(r0); n;)
+    {
+      if (auto const l(left_node(n)); l)
+      {
+        assign(n->l_, l->r_)(right_node(l), n);
+        n = l;
+      }
+      else
+      {
+        auto const r(right_node(n));
+
+        for (; (k != e.size()) && !s.f_[k]; ++k);
+
+        if ((k != e.size()) && (s.f_[k] == n))
+        {
+          t.set(n); t = slot_of(n->r_); ++k; ++sz;
+        }
+        else
+        {
+          destroy_node(a, n);
+        }
+
+        n = r;
+      }
+    }
+
+    t.set(nullptr);
+
+    set_parent(r0 = build(h, sz), nullptr); mx = sz;
+  }
+  else
+  {
+    auto const finish([&]() noexcept
+      {
+        sz = sz + s.c_ - s.n_;
+        compact(r0, sz, mx, s.n_);
+      }
+    );
+
+    try
+    {
+      if (auto const n(s(slot_of(r0), {}, 0, e.size(), 0)); n)
+      { // the root is the only scapegoat left
+        r0 = rebalance(r0, n);
+      }
+    }
+    catch (...)
+    {
+      finish();
+
+      throw;
+    }
+
+    finish();
+  }
+}
+
+inline auto emplace(auto& r, size_type const sz, auto const& k,
+  auto const& create_node) noexcept(noexcept(create_node()))
+{
+  using node_t = std::remove_pointer_t<std::remove_reference_t<decltype(r)>>;
+
+  struct S
+  {
+    decltype(k) k_;
+    decltype(create_node) create_node_;
+    size_type const h_;
+
+    node_t* q_;
+    bool s_;
+
+    explicit S(decltype(k) k, decltype(create_node) cn,
+      size_type const h) noexcept:
+      k_(k), create_node_(cn), h_(h)
+    {
+    }
+
+    void count(node_t* const r) const noexcept
+    { // a new node below r adds to the counts of r
+      if constexpr(Counted<node_t*>) r->c_ += s_;
+      if constexpr(Weighted<node_t*>) r->w_ += s_;
+    }
+
+    size_type operator()(slot<node_t> const q, node_t* const p,
+      size_type const d) noexcept(noexcept(create_node_()))
+    {
+      auto const r(q.get());
+
+      if (!r)
+      { // only a node deeper than h_ triggers the scapegoat search
+        assign(q_, s_)(q.set(create_node_()), true);
+        set_parent(q_, p);
+
+        return d > h_;
+      }
+
+      //
+      size_type sl, sr;
 
       if (auto const c(node_t::cmp(k_, r->key())); c < 0) [[likely]]
       {
-        if ((sl = (*this)(r->l_))) sr = size(r->r_); else return {};
+        sl = (*this)(slot_of(r->l_), r, d + 1);
+        count(r);
+
+        if (sl) sr = size(right_node(r)); else return {};
       }
       else if (c > 0) [[likely]]
       {
-        if ((sr = (*this)(r->r_))) sl = size(r->l_); else return {};
+        sr = (*this)(slot_of(r->r_), r, d + 1);
+        count(r);
+
+        if (sr) sl = size(left_node(r)); else return {};
       }
       else [[unlikely]]
       {
@@ -385,18 +1820,90 @@ inline auto emplace(auto& r, auto const& k, auto const& create_node)
       }
 
       //
-      auto const s(1 + sl + sr), S(2 * s);
+      auto const s(1 + sl + sr);
 
-      return (3 * sl > S) || (3 * sr > S) ? r = detail::rebalance(r, s),0 : s;
+      return unbalanced<typename node_t::alpha>(std::max(sl, sr), s) ?
+        q.set(detail::rebalance(r, s)), 0 : s;
     }
   };
 
   //
-  S s(k, create_node); s(r);
+  S s(k, create_node, max_depth<typename node_t::alpha>(sz + 1));
+  s(slot_of(r), {}, {});
 
   return std::pair(s.q_, s.s_);
 }
 
+inline auto emplace_hint(auto& r0, size_type const sz, auto const h,
+  auto const& k, auto const& create_node)
+  noexcept(noexcept(create_node()))
+{ // try to attach next to h first, only parent links make this cheap
+  using node_t = std::remove_pointer_t<std::remove_reference_t<decltype(r0)>>;
+
+  if constexpr(Parented<node_t*>)
+  {
+    node_t* const pr(h ? prev_node(r0, h) : r0 ? last_node(r0) : nullptr);
+
+    if (auto const c(h ? node_t::cmp(k, h->key()) : std::strong_ordering::less);
+      c == 0)
+    {
+      return std::pair(h, false);
+    }
+    else if (c < 0)
+    {
+      if (auto const c(pr ? node_t::cmp(k, pr->key()) :
+        std::strong_ordering::greater); c == 0)
+      {
+        return std::pair(pr, false);
+      }
+      else if (c > 0)
+      { // k fits between pr and h, one of them has a free slot
+        auto const a(h && !left_node(h) ? h : pr);
+        auto const n(create_node());
+
+        (a ? a == h ? slot_of(a->l_) : slot_of(a->r_) :
+          slot_of(r0)).set(n);
+        set_parent(n, a);
+
+        //
+        size_type d{};
+
+        for (auto m(a); m; m = m->p_, ++d);
+
+        if (d > max_depth<typename node_t::alpha>(sz + 1))
+        { // climb to the scapegoat, summing subtree sizes on the way
+          size_type s(1);
+
+          for (node_t* m(n), *p; (p = m->p_); m = p)
+          {
+            auto const sb(size(left_node(p) == m ? right_node(p) :
+              left_node(p)));
+            auto const sp(1 + s + sb);
+
+            if (unbalanced<typename node_t::alpha>(std::max(s, sb), sp))
+            {
+              node_t* const g(p->p_);
+
+              (g ? left_node(g) == p ? slot_of(g->l_) : slot_of(g->r_) :
+                slot_of(r0)).set(rebalance(p, sp));
+
+              break;
+            }
+
+            s = sp;
+          }
+        }
+
+        refresh(r0, n);
+
+        return std::pair(n, true);
+      }
+    }
+  }
+
+  return emplace(r0, sz, k, create_node);
+}
+
 }
 
 #endif // SG_UTILS_HPP